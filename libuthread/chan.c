@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iqueue.h"
+#include "preempt.h"
+#include "scheduler.h"
+#include "uthread.h"
+
+/*
+ * A channel is a ring buffer of capacity values, with the threads waiting to
+ * send or receive queued on the side. Everything is protected by disabling
+ * preemption, like the scheduler.
+ */
+struct uthread_chan {
+	size_t elemSize;
+	size_t capacity;
+	size_t head;
+	size_t length;
+	bool closed;
+	iqueue_t senders;
+	iqueue_t receivers;
+	char buffer[];
+};
+
+/*
+ * A blocked thread waits in its chan_wait, and has a chan_waiter queued on the
+ * channel of each operation it waits to perform. The first thread to perform
+ * one of them does it on its behalf, copying the value from or to its buffer,
+ * and wakes it up. The other waiters stay queued until it runs again and
+ * removes them: they are skipped meanwhile. Both live on the stack of the
+ * blocked thread, which is why threads on the shared stack cannot block.
+ */
+struct chan_wait {
+	iqueue_t thread;
+	int done; /* index of the operation performed, -1 until then */
+	bool closed;
+};
+
+struct chan_waiter {
+	iqueue_link_t link;
+	struct chan_wait *wait;
+	void *value;
+	int index;
+};
+
+uthread_chan_t uthread_chan_create(size_t elemsize, size_t capacity)
+{
+	if (capacity && elemsize > (SIZE_MAX - sizeof(struct uthread_chan)) / capacity)
+		return NULL;
+
+	uthread_chan_t chan = malloc(sizeof(struct uthread_chan) + elemsize * capacity);
+	if (!chan)
+		return NULL;
+	chan->elemSize = elemsize;
+	chan->capacity = capacity;
+	chan->head = 0;
+	chan->length = 0;
+	chan->closed = false;
+	iqueue_init(&chan->senders);
+	iqueue_init(&chan->receivers);
+	return chan;
+}
+
+int uthread_chan_destroy(uthread_chan_t chan)
+{
+	if (!chan)
+		return -1;
+
+	preempt_disable();
+	bool waited = iqueue_length(&chan->senders) || iqueue_length(&chan->receivers);
+	preempt_enable();
+	if (waited)
+		return -1;
+	free(chan);
+	return 0;
+}
+
+static void *slot(uthread_chan_t chan, size_t index)
+{
+	return chan->buffer + (index % chan->capacity) * chan->elemSize;
+}
+
+/*
+ * dequeue the oldest waiter of @queue which still waits
+ */
+static struct chan_waiter *dequeue_waiter(iqueue_t *queue)
+{
+	iqueue_link_t *link;
+
+	while ((link = iqueue_dequeue(queue)) != NULL) {
+		struct chan_waiter *waiter = iqueue_entry(link, struct chan_waiter, link);
+		if (waiter->wait->done < 0)
+			return waiter;
+	}
+	return NULL;
+}
+
+/*
+ * record that the operation of @waiter was performed, or
+ * failed if @closed is set
+ * Return value:
+ * link of the thread to wake up
+ */
+static iqueue_link_t *complete(struct chan_waiter *waiter, bool closed)
+{
+	waiter->wait->done = waiter->index;
+	waiter->wait->closed = closed;
+	return iqueue_dequeue(&waiter->wait->thread);
+}
+
+/*
+ * these perform an operation if it is possible right away
+ * must be called with preemption disabled
+ * Return value:
+ * 1 if the operation was performed, 0 if it would block,
+ * -1 if the channel is closed
+ */
+static int try_send(uthread_chan_t chan, const void *value)
+{
+	if (chan->closed)
+		return -1;
+
+	/* straight into the buffer of the receiver, which runs next */
+	struct chan_waiter *receiver = dequeue_waiter(&chan->receivers);
+	if (receiver) {
+		memcpy(receiver->value, value, chan->elemSize);
+		sched_handoff(complete(receiver, false));
+		return 1;
+	}
+
+	if (chan->length < chan->capacity) {
+		memcpy(slot(chan, chan->head + chan->length), value, chan->elemSize);
+		chan->length++;
+		return 1;
+	}
+	return 0;
+}
+
+static int try_recv(uthread_chan_t chan, void *value)
+{
+	struct chan_waiter *sender;
+
+	if (chan->length) {
+		memcpy(value, slot(chan, chan->head), chan->elemSize);
+		chan->head = (chan->head + 1) % chan->capacity;
+		chan->length--;
+		/* there is room for the value of the oldest sender */
+		sender = dequeue_waiter(&chan->senders);
+		if (sender) {
+			memcpy(slot(chan, chan->head + chan->length), sender->value, chan->elemSize);
+			chan->length++;
+			sched_wake(complete(sender, false));
+		}
+		return 1;
+	}
+
+	/* straight from the buffer of the sender */
+	sender = dequeue_waiter(&chan->senders);
+	if (sender) {
+		memcpy(value, sender->value, chan->elemSize);
+		sched_wake(complete(sender, false));
+		return 1;
+	}
+	return chan->closed ? -1 : 0;
+}
+
+int uthread_chan_close(uthread_chan_t chan)
+{
+	struct chan_waiter *waiter;
+
+	if (!chan)
+		return -1;
+
+	preempt_disable();
+	if (chan->closed) {
+		preempt_enable();
+		return -1;
+	}
+	chan->closed = true;
+	/* receivers only wait for an empty channel */
+	while ((waiter = dequeue_waiter(&chan->receivers)) != NULL)
+		sched_wake(complete(waiter, true));
+	while ((waiter = dequeue_waiter(&chan->senders)) != NULL)
+		sched_wake(complete(waiter, true));
+	preempt_enable();
+	return 0;
+}
+
+static iqueue_t *case_queue(uthread_chan_case_t *chanCase)
+{
+	return chanCase->send ? &chanCase->chan->senders : &chanCase->chan->receivers;
+}
+
+int uthread_chan_select(uthread_chan_case_t *cases, int ncases, int block)
+{
+	if (!cases || ncases <= 0)
+		return -1;
+
+	preempt_disable();
+	for (int i = 0; i < ncases; ++i) {
+		if (!cases[i].chan)
+			continue;
+		int ret = cases[i].send ? try_send(cases[i].chan, cases[i].value)
+					: try_recv(cases[i].chan, cases[i].value);
+		if (ret) {
+			cases[i].closed = ret < 0;
+			preempt_enable();
+			return i;
+		}
+	}
+	if (!block || sched_shared_stack()) {
+		preempt_enable();
+		return -1;
+	}
+
+	struct chan_wait wait;
+	struct chan_waiter waiters[ncases];
+	iqueue_init(&wait.thread);
+	wait.done = -1;
+	for (int i = 0; i < ncases; ++i) {
+		waiters[i].wait = &wait;
+		waiters[i].value = cases[i].value;
+		waiters[i].index = i;
+		if (cases[i].chan)
+			iqueue_enqueue(case_queue(&cases[i]), &waiters[i].link);
+	}
+	sched_block(&wait.thread);
+
+	/* the waiters which were not picked are still queued */
+	for (int i = 0; i < ncases; ++i) {
+		if (cases[i].chan && waiters[i].link.next)
+			iqueue_remove(case_queue(&cases[i]), &waiters[i].link);
+	}
+	cases[wait.done].closed = wait.closed;
+	preempt_enable();
+	return wait.done;
+}
+
+int uthread_chan_send(uthread_chan_t chan, const void *value)
+{
+	uthread_chan_case_t chanCase = {.chan = chan, .send = 1, .value = (void*)value};
+
+	if (!chan || uthread_chan_select(&chanCase, 1, 1) < 0)
+		return -1;
+	return chanCase.closed ? -1 : 0;
+}
+
+int uthread_chan_recv(uthread_chan_t chan, void *value)
+{
+	uthread_chan_case_t chanCase = {.chan = chan, .send = 0, .value = value};
+
+	if (!chan || uthread_chan_select(&chanCase, 1, 1) < 0)
+		return -1;
+	return chanCase.closed ? -1 : 0;
+}
@@ -1,13 +1,108 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "context.h"
 #include "preempt.h"
 #include "uthread.h"
 
-/* Size of the stack for a thread (in bytes) */
-#define UTHREAD_STACK_SIZE 32768
+/* Default number of idle stacks kept around for reuse, per size class */
+#define UTHREAD_STACK_POOL_HIGH_WATER 64
 
+/*
+ * Pooled stack sizes are rounded up to a power of two, from UTHREAD_STACK_MIN
+ * up to 8 MiB. Bigger stacks are mapped and unmapped on demand.
+ */
+#define UTHREAD_STACK_POOL_CLASSES 11
+
+/*
+ * Stacks released by finished threads are kept in a LIFO array and handed
+ * back to the next created threads, so that the hot stacks (whose pages are
+ * still mapped and cached) get reused first. The oldest @trimmed entries at
+ * the bottom of the array have been given back to the kernel with madvise()
+ * and will fault in fresh zero pages when reused.
+ *
+ * There is one such array per stack size class, and one set of arrays per
+ * kernel thread, so that independent schedulers never share a pool.
+ */
+struct stack_pool {
+	void **idle;
+	size_t count;
+	size_t trimmed;
+};
+
+static __thread struct stack_pool stackPool[UTHREAD_STACK_POOL_CLASSES];
+static __thread size_t stackPoolHighWater = UTHREAD_STACK_POOL_HIGH_WATER;
+
+#ifdef UTHREAD_CTX_NATIVE
+/*
+ * uthread_ctx_swap - Save the callee-saved state in @prev and resume @next
+ *
+ * Since this is a regular function call, the compiler already assumes every
+ * caller-saved register is clobbered: we only have to keep what the ABI
+ * promises to preserve. The saved resume address is our own return address,
+ * so resuming @prev looks like uthread_ctx_swap() returning normally. Unlike
+ * swapcontext(), no signal mask is saved or restored, hence no syscall.
+ */
+void uthread_ctx_swap(uthread_ctx_t *prev, uthread_ctx_t *next);
+
+/*
+ * uthread_ctx_trampoline - First code run by a new context
+ *
+ * uthread_ctx_init() leaves the bootstrap function in %r14 and its two
+ * arguments in %r12 and %r13. The stack is realigned so that the bootstrap
+ * function is entered exactly as if it had been called.
+ */
+void uthread_ctx_trampoline(void);
+
+__asm__(
+	".text\n"
+	".globl uthread_ctx_swap\n"
+	".hidden uthread_ctx_swap\n"
+	".type uthread_ctx_swap, @function\n"
+	"uthread_ctx_swap:\n"
+	"	movq (%rsp), %rax\n"
+	"	leaq 8(%rsp), %rcx\n"
+	"	movq %rax, 0(%rdi)\n"
+	"	movq %rcx, 8(%rdi)\n"
+	"	movq %rbx, 16(%rdi)\n"
+	"	movq %rbp, 24(%rdi)\n"
+	"	movq %r12, 32(%rdi)\n"
+	"	movq %r13, 40(%rdi)\n"
+	"	movq %r14, 48(%rdi)\n"
+	"	movq %r15, 56(%rdi)\n"
+	"	stmxcsr 64(%rdi)\n"
+	"	fnstcw 68(%rdi)\n"
+	"	movq 8(%rsi), %rsp\n"
+	"	movq 16(%rsi), %rbx\n"
+	"	movq 24(%rsi), %rbp\n"
+	"	movq 32(%rsi), %r12\n"
+	"	movq 40(%rsi), %r13\n"
+	"	movq 48(%rsi), %r14\n"
+	"	movq 56(%rsi), %r15\n"
+	"	ldmxcsr 64(%rsi)\n"
+	"	fldcw 68(%rsi)\n"
+	"	jmpq *0(%rsi)\n"
+	".size uthread_ctx_swap, .-uthread_ctx_swap\n"
+	"\n"
+	".globl uthread_ctx_trampoline\n"
+	".hidden uthread_ctx_trampoline\n"
+	".type uthread_ctx_trampoline, @function\n"
+	"uthread_ctx_trampoline:\n"
+	"	movq %r12, %rdi\n"
+	"	movq %r13, %rsi\n"
+	"	andq $-16, %rsp\n"
+	"	callq *%r14\n"
+	"	ud2\n"
+	".size uthread_ctx_trampoline, .-uthread_ctx_trampoline\n"
+);
+
+void uthread_ctx_switch(uthread_ctx_t *prev, uthread_ctx_t *next)
+{
+	uthread_ctx_swap(prev, next);
+}
+#else
 void uthread_ctx_switch(uthread_ctx_t *prev, uthread_ctx_t *next)
 {
 	/*
@@ -19,15 +114,178 @@ void uthread_ctx_switch(uthread_ctx_t *prev, uthread_ctx_t *next)
 		exit(1);
 	}
 }
+#endif
+
+static size_t page_size(void)
+{
+	static size_t pageSize;
+
+	if (!pageSize)
+		pageSize = sysconf(_SC_PAGESIZE);
+	return pageSize;
+}
+
+/*
+ * Return the pool size class of a stack of @size bytes, or -1 if stacks of
+ * that size are not pooled. The class size is stored in @classSize.
+ */
+static int stack_pool_class(size_t size, size_t *classSize)
+{
+	size_t s = UTHREAD_STACK_MIN;
+
+	for (int c = 0; c < UTHREAD_STACK_POOL_CLASSES; ++c, s <<= 1) {
+		if (size <= s) {
+			*classSize = s;
+			return c;
+		}
+	}
+	return -1;
+}
+
+/*
+ * A stack is an anonymous private mapping with an inaccessible guard page
+ * right below it, so that a stack overflow faults instead of silently
+ * corrupting whatever lies below. Pages are only backed by memory once
+ * touched, so large stacks cost little until they are actually used.
+ */
+static void *stack_map(size_t size)
+{
+	size_t guard = page_size();
+	char *map = mmap(NULL, size + guard, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+			 -1, 0);
+
+	if (map == MAP_FAILED)
+		return NULL;
+	if (mprotect(map, guard, PROT_NONE)) {
+		munmap(map, size + guard);
+		return NULL;
+	}
+	return map + guard;
+}
+
+static void stack_unmap(void *stack, size_t size)
+{
+	size_t guard = page_size();
+
+	munmap((char *)stack - guard, size + guard);
+}
+
+/*
+ * Make sure the idle array of @pool can hold up to @highWater stacks
+ */
+static int stack_pool_reserve(struct stack_pool *pool, size_t highWater)
+{
+	void **idle = realloc(pool->idle, highWater * sizeof(void *));
+
+	if (!idle && highWater)
+		return -1;
+	pool->idle = idle;
+	return 0;
+}
 
-void *uthread_ctx_alloc_stack(void)
+void *uthread_ctx_alloc_stack(size_t *size)
 {
-	return malloc(UTHREAD_STACK_SIZE);
+	size_t classSize;
+	int c = stack_pool_class(*size, &classSize);
+
+	if (c < 0) {
+		*size = (*size + page_size() - 1) & ~(page_size() - 1);
+		return stack_map(*size);
+	}
+
+	*size = classSize;
+	struct stack_pool *pool = &stackPool[c];
+	if (pool->count == 0)
+		return stack_map(classSize);
+
+	void *stack = pool->idle[--pool->count];
+	if (pool->trimmed > pool->count)
+		pool->trimmed = pool->count;
+	return stack;
 }
 
-void uthread_ctx_destroy_stack(void *top_of_stack)
+void uthread_ctx_destroy_stack(void *top_of_stack, size_t size)
 {
-	free(top_of_stack);
+	size_t classSize;
+	int c;
+
+	if (!top_of_stack)
+		return;
+
+	c = stack_pool_class(size, &classSize);
+	if (c < 0) {
+		stack_unmap(top_of_stack, size);
+		return;
+	}
+
+	struct stack_pool *pool = &stackPool[c];
+	if (pool->count >= stackPoolHighWater
+	    || (!pool->idle && stack_pool_reserve(pool, stackPoolHighWater))) {
+		stack_unmap(top_of_stack, classSize);
+		return;
+	}
+	pool->idle[pool->count++] = top_of_stack;
+}
+
+/*
+ * configure the pool of the calling kernel thread, see
+ * uthread_stack_pool_config()
+ */
+static int stack_pool_config(size_t high_water, size_t prefill)
+{
+	size_t classSize = UTHREAD_STACK_MIN;
+
+	for (int c = 0; c < UTHREAD_STACK_POOL_CLASSES; ++c, classSize <<= 1) {
+		struct stack_pool *pool = &stackPool[c];
+
+		/* Release whatever no longer fits under the new mark */
+		while (pool->count > high_water)
+			stack_unmap(pool->idle[--pool->count], classSize);
+		if (pool->trimmed > pool->count)
+			pool->trimmed = pool->count;
+		if (pool->idle && stack_pool_reserve(pool, high_water))
+			return -1;
+	}
+	stackPoolHighWater = high_water;
+
+	if (prefill > high_water)
+		prefill = high_water;
+	int c = stack_pool_class(UTHREAD_STACK_SIZE, &classSize);
+	struct stack_pool *pool = &stackPool[c];
+	if (prefill && !pool->idle && stack_pool_reserve(pool, high_water))
+		return -1;
+	while (pool->count < prefill) {
+		void *stack = stack_map(classSize);
+		if (!stack)
+			return -1;
+		pool->idle[pool->count++] = stack;
+	}
+	return 0;
+}
+
+int uthread_stack_pool_config(size_t high_water, size_t prefill)
+{
+	/* Threads of this kernel thread use the pool as well */
+	preempt_disable();
+	int ret = stack_pool_config(high_water, prefill);
+	preempt_enable();
+	return ret;
+}
+
+void uthread_stack_pool_trim(void)
+{
+	size_t classSize = UTHREAD_STACK_MIN;
+
+	preempt_disable();
+	for (int c = 0; c < UTHREAD_STACK_POOL_CLASSES; ++c, classSize <<= 1) {
+		struct stack_pool *pool = &stackPool[c];
+
+		for (size_t i = pool->trimmed; i < pool->count; ++i)
+			madvise(pool->idle[i], classSize, MADV_DONTNEED);
+		pool->trimmed = pool->count;
+	}
+	preempt_enable();
 }
 
 /*
@@ -46,8 +304,81 @@ static void uthread_ctx_bootstrap(uthread_func_t func, void *arg)
 	uthread_exit(func(arg));
 }
 
+#ifdef UTHREAD_CTX_NATIVE
+/*
+ * uthread_ctx_prepare - Set up @uctx to call @entry(@arg1, @arg2) on its stack
+ */
+static void uthread_ctx_prepare(uthread_ctx_t *uctx, void *top_of_stack,
+				size_t stack_size, void *entry,
+				void *arg1, void *arg2)
+{
+	/* Default control words, as set up by the kernel for a new process */
+	static const uint32_t defaultMxcsr = 0x1f80;
+	static const uint16_t defaultFpucw = 0x037f;
+
+	/*
+	 * The stack grows down from the end of the segment. The first switch to
+	 * @uctx jumps into uthread_ctx_trampoline(), which calls
+	 * @entry(@arg1, @arg2).
+	 */
+	uintptr_t sp = (uintptr_t)top_of_stack + stack_size;
+	sp &= ~(uintptr_t)15;
+
+	uctx->rip = (void *)uthread_ctx_trampoline;
+	uctx->rsp = (void *)sp;
+	uctx->rbx = NULL;
+	uctx->rbp = NULL;
+	uctx->r12 = arg1;
+	uctx->r13 = arg2;
+	uctx->r14 = entry;
+	uctx->r15 = NULL;
+	uctx->mxcsr = defaultMxcsr;
+	uctx->fpucw = defaultFpucw;
+}
+
 int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
-		     uthread_func_t func, void *arg)
+		     size_t stack_size, uthread_func_t func, void *arg)
+{
+	if (!uctx || !top_of_stack)
+		return -1;
+
+	uthread_ctx_prepare(uctx, top_of_stack, stack_size,
+			    (void *)uthread_ctx_bootstrap, (void *)func, arg);
+	return 0;
+}
+
+int uthread_ctx_template(uthread_ctx_t *tmpl)
+{
+	/* nothing to capture, the control words are constants */
+	return tmpl ? 0 : -1;
+}
+
+void uthread_ctx_init_from(uthread_ctx_t *uctx, const uthread_ctx_t *tmpl,
+			   void *top_of_stack, size_t stack_size,
+			   uthread_func_t func, void *arg)
+{
+	uthread_ctx_prepare(uctx, top_of_stack, stack_size,
+			    (void *)uthread_ctx_bootstrap, (void *)func, arg);
+}
+
+int uthread_ctx_init_plain(uthread_ctx_t *uctx, void *top_of_stack,
+			   size_t stack_size, void (*func)(void *), void *arg)
+{
+	if (!uctx || !top_of_stack)
+		return -1;
+
+	uthread_ctx_prepare(uctx, top_of_stack, stack_size,
+			    (void *)func, arg, NULL);
+	return 0;
+}
+
+void *uthread_ctx_get_sp(uthread_ctx_t *uctx)
+{
+	return uctx->rsp;
+}
+#else
+int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
+		     size_t stack_size, uthread_func_t func, void *arg)
 {
 	/*
 	 * Initialize the passed context @uctx to the currently active context
@@ -59,7 +390,7 @@ int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
 	 * Change context @uctx's stack to the specified stack
 	 */
 	uctx->uc_stack.ss_sp = top_of_stack;
-	uctx->uc_stack.ss_size = UTHREAD_STACK_SIZE;
+	uctx->uc_stack.ss_size = stack_size;
 
 	/*
 	 * Finish setting up context @uctx:
@@ -74,3 +405,38 @@ int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
 	return 0;
 }
 
+int uthread_ctx_template(uthread_ctx_t *tmpl)
+{
+	if (!tmpl || getcontext(tmpl))
+		return -1;
+	return 0;
+}
+
+void uthread_ctx_init_from(uthread_ctx_t *uctx, const uthread_ctx_t *tmpl,
+			   void *top_of_stack, size_t stack_size,
+			   uthread_func_t func, void *arg)
+{
+	*uctx = *tmpl;
+#if defined(__x86_64__) && defined(__GLIBC__)
+	/* the floating-point state is pointed to, and must be our own copy */
+	uctx->uc_mcontext.fpregs = &uctx->__fpregs_mem;
+#endif
+	uctx->uc_stack.ss_sp = top_of_stack;
+	uctx->uc_stack.ss_size = stack_size;
+	makecontext(uctx, (void (*)(void)) uthread_ctx_bootstrap,
+		    2, func, arg);
+}
+
+int uthread_ctx_init_plain(uthread_ctx_t *uctx, void *top_of_stack,
+			   size_t stack_size, void (*func)(void *), void *arg)
+{
+	if (!uctx || !top_of_stack || getcontext(uctx))
+		return -1;
+
+	uctx->uc_stack.ss_sp = top_of_stack;
+	uctx->uc_stack.ss_size = stack_size;
+	makecontext(uctx, (void (*)(void)) func, 1, arg);
+
+	return 0;
+}
+#endif
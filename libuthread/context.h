@@ -1,10 +1,21 @@
 #ifndef _CONTEXT_H
 #define _CONTEXT_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <ucontext.h>
 
 #include "uthread.h"
 
+/*
+ * The native context switch is only available on x86-64. Everywhere else, or
+ * when the library is built with `make UCONTEXT=1`, we fall back on
+ * swapcontext().
+ */
+#if defined(__x86_64__) && !defined(UTHREAD_USE_UCONTEXT)
+#define UTHREAD_CTX_NATIVE 1
+#endif
+
 /*
  * uthread_ctx_t - User-level thread context
  *
@@ -13,8 +24,27 @@
  *
  * Such a context is initialized for the first time when creating a thread with
  * uthread_ctx_init(). O.
+ *
+ * The native context only holds what the System V ABI requires a callee to
+ * preserve: the callee-saved registers, the stack pointer, the resume address
+ * and the floating-point control words. The signal mask is not part of it.
  */
+#ifdef UTHREAD_CTX_NATIVE
+typedef struct uthread_ctx {
+	void *rip;
+	void *rsp;
+	void *rbx;
+	void *rbp;
+	void *r12;
+	void *r13;
+	void *r14;
+	void *r15;
+	uint32_t mxcsr;
+	uint16_t fpucw;
+} uthread_ctx_t;
+#else
 typedef ucontext_t uthread_ctx_t;
+#endif
 
 /*
  * uthread_ctx_switch - Switch between two execution contexts
@@ -26,29 +56,101 @@ void uthread_ctx_switch(uthread_ctx_t *prev, uthread_ctx_t *next);
 
 /*
  * uthread_ctx_alloc_stack - Allocate stack segment
+ * @size: Address of the requested stack size (in bytes), which receives the
+ *	actual size of the allocated segment
+ *
+ * The requested size is rounded up to its pool size class, or to a multiple
+ * of the page size for stacks too big to be pooled. The most recently released
+ * stack of that class is reused if there is one, otherwise a new stack is
+ * mapped, with a guard page below it.
+ *
+ * Each kernel thread has a stack pool of its own, which is not protected
+ * against preemption: this function must be called with preemption disabled
+ * once threads are running.
  *
  * Return: Pointer to the top of a valid stack segment, or NULL in case of
  * failure
  */
-void *uthread_ctx_alloc_stack(void);
+void *uthread_ctx_alloc_stack(size_t *size);
 
 /*
  * uthread_ctx_destroy_stack - Deallocate stack segment
  * @top_of_stack: Address of stack to deallocate
+ * @size: Size of the stack, as returned by uthread_ctx_alloc_stack()
+ *
+ * The stack is kept in the stack pool for reuse, unless the pool of its size
+ * class already holds as many idle stacks as the high-water mark. Same
+ * preemption requirement as uthread_ctx_alloc_stack().
  */
-void uthread_ctx_destroy_stack(void *top_of_stack);
+void uthread_ctx_destroy_stack(void *top_of_stack, size_t size);
 
 /*
  * uthread_ctx_init - Initialize a thread's execution context
  * @uctx: Pointer to thread context to initialize
  * @top_of_stack: Pointer to the top of a valid stack segment, as allocated by
  *	uthread_ctx_alloc_stack()
+ * @stack_size: Size of the stack segment
  * @func: Function to be executed by the thread
  * @arg: Argument to pass to the thread
  *
  * Return: 0 if @uctx was properly initialized, or -1 in case of failure
  */
 int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
-		     uthread_func_t func, void *arg);
+		     size_t stack_size, uthread_func_t func, void *arg);
+
+/*
+ * uthread_ctx_template - Capture the state shared by new thread contexts
+ * @tmpl: Pointer to the template context to initialize
+ *
+ * Return: 0 if @tmpl was properly initialized, or -1 in case of failure
+ */
+int uthread_ctx_template(uthread_ctx_t *tmpl);
+
+/*
+ * uthread_ctx_init_from - Initialize a thread's execution context from a
+ * template
+ * @uctx: Pointer to thread context to initialize
+ * @tmpl: Template, as initialized by uthread_ctx_template()
+ * @top_of_stack: Pointer to the top of a valid stack segment, as allocated by
+ *	uthread_ctx_alloc_stack()
+ * @stack_size: Size of the stack segment
+ * @func: Function to be executed by the thread
+ * @arg: Argument to pass to the thread
+ *
+ * Same as uthread_ctx_init(), but what does not depend on the thread comes
+ * from @tmpl instead of being captured again, which saves a system call per
+ * context with ucontext. Meant to initialize many contexts at once.
+ */
+void uthread_ctx_init_from(uthread_ctx_t *uctx, const uthread_ctx_t *tmpl,
+			   void *top_of_stack, size_t stack_size,
+			   uthread_func_t func, void *arg);
+
+/*
+ * uthread_ctx_init_plain - Initialize a bare execution context
+ * @uctx: Pointer to context to initialize
+ * @top_of_stack: Pointer to the top of a valid stack segment
+ * @stack_size: Size of the stack segment
+ * @func: Function to be executed in the context, which must never return
+ * @arg: Argument to pass to @func
+ *
+ * Unlike uthread_ctx_init(), the context does not go through the thread
+ * bootstrap: preemption is left untouched and no thread exit is performed. It
+ * is meant for the library's own helper contexts.
+ *
+ * Return: 0 if @uctx was properly initialized, or -1 in case of failure
+ */
+int uthread_ctx_init_plain(uthread_ctx_t *uctx, void *top_of_stack,
+			   size_t stack_size, void (*func)(void *), void *arg);
+
+#ifdef UTHREAD_CTX_NATIVE
+/*
+ * uthread_ctx_get_sp - Get the stack pointer saved in a context
+ * @uctx: Context that was switched out of, or freshly initialized
+ *
+ * Everything the context still needs lives between the returned address and
+ * the top of its stack segment.
+ */
+void *uthread_ctx_get_sp(uthread_ctx_t *uctx);
+#endif
 
 #endif /* _CONTEXT_H */
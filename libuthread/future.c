@@ -0,0 +1,177 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "iqueue.h"
+#include "preempt.h"
+#include "scheduler.h"
+#include "uthread.h"
+
+/*
+ * A future is pending until its result is set, once. Threads getting it
+ * meanwhile wait in its queue, and continuations are queued on the side. The
+ * queues are protected by disabling preemption, like the scheduler, but a
+ * future which is done can be read without.
+ */
+struct uthread_future {
+	atomic_bool done;
+	void *result;
+	iqueue_t waiters;
+	iqueue_t continuations;
+};
+
+/*
+ * A continuation sets @future to the result of @func, once the future it was
+ * attached to is done, with that future's result in @result.
+ */
+struct continuation {
+	iqueue_link_t link;
+	uthread_future_then_t func;
+	void *arg;
+	void *result;
+	uthread_future_t future;
+};
+
+uthread_future_t uthread_future_create(void)
+{
+	uthread_future_t future = malloc(sizeof(struct uthread_future));
+	if (!future)
+		return NULL;
+	atomic_init(&future->done, false);
+	future->result = NULL;
+	iqueue_init(&future->waiters);
+	iqueue_init(&future->continuations);
+	return future;
+}
+
+int uthread_future_destroy(uthread_future_t future)
+{
+	if (!future)
+		return -1;
+
+	preempt_disable();
+	/* the futures of the continuations could never be done */
+	bool busy = iqueue_length(&future->waiters) || iqueue_length(&future->continuations);
+	preempt_enable();
+	if (busy)
+		return -1;
+	free(future);
+	return 0;
+}
+
+/*
+ * set the result of @future and wake its waiters up, and move its
+ * continuations to @ready with the result
+ * Return value:
+ * -1 if @future was already done, 0 otherwise
+ */
+static int complete(uthread_future_t future, void *result, iqueue_t *ready)
+{
+	iqueue_link_t *link;
+
+	preempt_disable();
+	if (atomic_load_explicit(&future->done, memory_order_relaxed)) {
+		preempt_enable();
+		return -1;
+	}
+	future->result = result;
+	while ((link = iqueue_dequeue(&future->waiters)) != NULL)
+		sched_wake(link);
+	while ((link = iqueue_dequeue(&future->continuations)) != NULL) {
+		iqueue_entry(link, struct continuation, link)->result = result;
+		iqueue_enqueue(ready, link);
+	}
+	/* last: a thread seeing it may destroy the future right away */
+	atomic_store_explicit(&future->done, true, memory_order_release);
+	preempt_enable();
+	return 0;
+}
+
+/*
+ * run the continuations of @ready, and those of the futures they
+ * complete in turn, without going deeper on the stack
+ */
+static void run_continuations(iqueue_t *ready)
+{
+	iqueue_link_t *link;
+
+	while ((link = iqueue_dequeue(ready)) != NULL) {
+		struct continuation *cont = iqueue_entry(link, struct continuation, link);
+		void *result = cont->func(cont->result, cont->arg);
+		complete(cont->future, result, ready);
+		free(cont);
+	}
+}
+
+int uthread_future_set(uthread_future_t future, void *result)
+{
+	iqueue_t ready;
+
+	if (!future)
+		return -1;
+
+	iqueue_init(&ready);
+	if (complete(future, result, &ready))
+		return -1;
+	run_continuations(&ready);
+	return 0;
+}
+
+int uthread_future_get(uthread_future_t future, void **result)
+{
+	if (!future)
+		return -1;
+
+	if (!atomic_load_explicit(&future->done, memory_order_acquire)) {
+		preempt_disable();
+		if (!atomic_load_explicit(&future->done, memory_order_relaxed))
+			sched_block(&future->waiters);
+		preempt_enable();
+	}
+	if (result)
+		*result = future->result;
+	return 0;
+}
+
+int uthread_future_tryget(uthread_future_t future, void **result)
+{
+	if (!future || !atomic_load_explicit(&future->done, memory_order_acquire))
+		return -1;
+	if (result)
+		*result = future->result;
+	return 0;
+}
+
+uthread_future_t uthread_future_then(uthread_future_t future, uthread_future_then_t func,
+				     void *arg)
+{
+	iqueue_t ready;
+
+	if (!future || !func)
+		return NULL;
+
+	struct continuation *cont = malloc(sizeof(struct continuation));
+	uthread_future_t next = uthread_future_create();
+	if (!cont || !next) {
+		free(cont);
+		free(next);
+		return NULL;
+	}
+	cont->func = func;
+	cont->arg = arg;
+	cont->future = next;
+
+	iqueue_init(&ready);
+	preempt_disable();
+	if (atomic_load_explicit(&future->done, memory_order_relaxed)) {
+		cont->result = future->result;
+		iqueue_enqueue(&ready, &cont->link);
+	} else {
+		iqueue_enqueue(&future->continuations, &cont->link);
+	}
+	preempt_enable();
+	/* already done: it runs right away, in the calling thread */
+	run_continuations(&ready);
+	return next;
+}
@@ -0,0 +1,111 @@
+#ifndef _IQUEUE_H
+#define _IQUEUE_H
+
+#include <stddef.h>
+
+#include "uthread.h"
+
+/*
+ * iqueue_t - Intrusive queue type
+ *
+ * An intrusive queue is a FIFO queue whose items embed their own link
+ * (iqueue_link_t) rather than being wrapped in a node allocated by the queue.
+ * Enqueuing and dequeuing therefore never allocate memory, and an item whose
+ * address is known can be removed from the middle of the queue in O(1).
+ *
+ * An item can only be in one queue at a time through a given link. All
+ * operations are O(1).
+ *
+ * The queue is a circular doubly linked list going through @head, which is a
+ * sentinel and not an item. The types are the wait queues of uthread.h, which
+ * the synchronization objects embed without seeing this header.
+ */
+typedef struct uthread_wait_link iqueue_link_t;
+typedef struct uthread_wait_queue iqueue_t;
+
+/*
+ * iqueue_entry - Get the item embedding a link
+ * @link: Address of the link
+ * @type: Type of the item
+ * @member: Name of the link member in @type
+ */
+#define iqueue_entry(link, type, member) \
+	((type *)((char *)(link) - offsetof(type, member)))
+
+/*
+ * iqueue_init - Initialize an empty intrusive queue
+ * @queue: Queue to initialize
+ */
+static inline void iqueue_init(iqueue_t *queue)
+{
+	queue->head.prev = &queue->head;
+	queue->head.next = &queue->head;
+	queue->length = 0;
+}
+
+/*
+ * iqueue_length - Intrusive queue length
+ * @queue: Queue to get the length of
+ */
+static inline int iqueue_length(iqueue_t *queue)
+{
+	return queue->length;
+}
+
+/*
+ * iqueue_enqueue - Enqueue an item at the tail of the queue
+ * @queue: Queue in which to enqueue the item
+ * @link: Link of the item, which must not be in any queue
+ */
+static inline void iqueue_enqueue(iqueue_t *queue, iqueue_link_t *link)
+{
+	link->prev = queue->head.prev;
+	link->next = &queue->head;
+	queue->head.prev->next = link;
+	queue->head.prev = link;
+	queue->length++;
+}
+
+/*
+ * iqueue_remove - Remove an item from the queue
+ * @queue: Queue the item is in
+ * @link: Link of the item to remove
+ */
+static inline void iqueue_remove(iqueue_t *queue, iqueue_link_t *link)
+{
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+	link->prev = NULL;
+	link->next = NULL;
+	queue->length--;
+}
+
+/*
+ * iqueue_peek - Get the oldest item of the queue, without removing it
+ * @queue: Queue to look into
+ *
+ * Return: Link of the oldest item, or NULL if @queue is empty
+ */
+static inline iqueue_link_t *iqueue_peek(iqueue_t *queue)
+{
+	if (queue->head.next == &queue->head)
+		return NULL;
+	return queue->head.next;
+}
+
+/*
+ * iqueue_dequeue - Dequeue the oldest item of the queue
+ * @queue: Queue in which to dequeue the item
+ *
+ * Return: Link of the oldest item, or NULL if @queue is empty
+ */
+static inline iqueue_link_t *iqueue_dequeue(iqueue_t *queue)
+{
+	iqueue_link_t *link = iqueue_peek(queue);
+
+	if (link)
+		iqueue_remove(queue, link);
+	return link;
+}
+
+#endif /* _IQUEUE_H */
@@ -0,0 +1,140 @@
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpmc_queue.h"
+#include "slab.h"
+
+/*
+ * Bounded MPMC queue after Dmitry Vyukov's design.
+ *
+ * Slot i of the ring holds the item of position pos (with
+ * pos & mask == i) when its sequence is pos + 1, and is
+ * free for position pos when its sequence is pos. Taking
+ * a position is a CAS on enqueuePos (or dequeuePos), and
+ * publishing the slot is a release store of its sequence.
+ * After a dequeue, the sequence jumps one lap ahead so the
+ * slot becomes free for position pos + capacity.
+ */
+struct cell {
+    atomic_size_t sequence;
+    void *data;
+};
+
+struct mpmc_queue {
+    struct cell *buffer;
+    size_t mask;
+    //producers and consumers don't share cache lines
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueuePos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeuePos;
+};
+
+mpmc_queue_t mpmc_queue_create(size_t capacity)
+{
+    if(capacity == 0 || capacity > INT_MAX)
+        return NULL;
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+
+    mpmc_queue_t myQueue;
+    if(posix_memalign((void**)&myQueue, CACHE_LINE_SIZE, sizeof(struct mpmc_queue))){
+        perror("posix_memalign");
+        return NULL;
+    }
+    myQueue->buffer = malloc(size * sizeof(struct cell));
+    if(!myQueue->buffer){
+        perror("malloc");
+        free(myQueue);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; ++i)
+        atomic_init(&myQueue->buffer[i].sequence, i);
+    myQueue->mask = size - 1;
+    atomic_init(&myQueue->enqueuePos, 0);
+    atomic_init(&myQueue->dequeuePos, 0);
+    return myQueue;
+}
+
+int mpmc_queue_destroy(mpmc_queue_t queue)
+{
+    if(!queue || mpmc_queue_length(queue) > 0)
+        return -1;
+    free(queue->buffer);
+    free(queue);
+    return 0;
+}
+
+int mpmc_queue_enqueue(mpmc_queue_t queue, void *data)
+{
+    if(!queue || !data)
+        return -1;
+
+    struct cell *cell;
+    size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    while(1){
+        cell = &queue->buffer[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0){
+            //slot is free for our position, try to take the position
+            if(atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed))
+                break;
+        }else if(diff < 0){
+            //slot still holds the item of the previous lap: full
+            return -1;
+        }else{
+            //another producer took this position
+            pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->data = data;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return 0;
+}
+
+int mpmc_queue_dequeue(mpmc_queue_t queue, void **data)
+{
+    if(!queue || !data)
+        return -1;
+
+    struct cell *cell;
+    size_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    while(1){
+        cell = &queue->buffer[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0){
+            //slot holds the item of our position, try to take the position
+            if(atomic_compare_exchange_weak_explicit(&queue->dequeuePos, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed))
+                break;
+        }else if(diff < 0){
+            //slot not filled yet: empty
+            return -1;
+        }else{
+            //another consumer took this position
+            pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+        }
+    }
+    *data = cell->data;
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return 0;
+}
+
+int mpmc_queue_length(mpmc_queue_t queue)
+{
+    if(!queue)
+        return -1;
+    size_t dequeuePos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    size_t enqueuePos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    //positions are read one after the other, clamp what races produced
+    if(enqueuePos <= dequeuePos)
+        return 0;
+    if(enqueuePos - dequeuePos > queue->mask + 1)
+        return queue->mask + 1;
+    return enqueuePos - dequeuePos;
+}
@@ -0,0 +1,75 @@
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+#include <stddef.h>
+
+/*
+ * mpmc_queue_t - Bounded multi-producer/multi-consumer queue type
+ *
+ * Unlike queue_t, an MPMC queue can be used concurrently from any number of
+ * kernel threads (pthreads) without a lock: any thread can enqueue and any
+ * thread can dequeue at the same time. It is meant to hand work over from
+ * ordinary pthreads to the uthread runtime and back.
+ *
+ * The queue is a FIFO of fixed capacity: enqueuing into a full queue fails
+ * instead of blocking or growing. Every slot of the underlying ring carries a
+ * sequence number telling producers and consumers whose turn it is, so each
+ * operation costs a single compare-and-swap when uncontended and never
+ * allocates memory. No operation ever blocks: if the slot it needs is still
+ * being filled (or emptied) by a thread which was descheduled in the middle of
+ * its own operation, the queue is reported as empty (or full) for now.
+ */
+typedef struct mpmc_queue* mpmc_queue_t;
+
+/*
+ * mpmc_queue_create - Allocate an empty MPMC queue
+ * @capacity: Maximum number of items, rounded up to a power of two
+ *
+ * Return: Pointer to new empty queue. NULL if @capacity is 0 or too large, or
+ * in case of failure when allocating the new queue.
+ */
+mpmc_queue_t mpmc_queue_create(size_t capacity);
+
+/*
+ * mpmc_queue_destroy - Deallocate an MPMC queue
+ * @queue: Queue to deallocate
+ *
+ * No other thread may use @queue while or after it is destroyed.
+ *
+ * Return: -1 if @queue is NULL or if @queue is not empty. 0 if @queue was
+ * successfully destroyed.
+ */
+int mpmc_queue_destroy(mpmc_queue_t queue);
+
+/*
+ * mpmc_queue_enqueue - Enqueue data item
+ * @queue: Queue in which to enqueue item
+ * @data: Address of data item to enqueue
+ *
+ * Return: -1 if @queue or @data are NULL, or if @queue is full. 0 if @data was
+ * successfully enqueued in @queue.
+ */
+int mpmc_queue_enqueue(mpmc_queue_t queue, void *data);
+
+/*
+ * mpmc_queue_dequeue - Dequeue data item
+ * @queue: Queue in which to dequeue item
+ * @data: Address of data pointer where item is received
+ *
+ * Return: -1 if @queue or @data are NULL, or if the queue is empty. 0 if @data
+ * was set with the oldest item available in @queue.
+ */
+int mpmc_queue_dequeue(mpmc_queue_t queue, void **data);
+
+/*
+ * mpmc_queue_length - MPMC queue length
+ * @queue: Queue to get the length of
+ *
+ * With concurrent producers or consumers, the length may already be stale when
+ * it is returned.
+ *
+ * Return: -1 if @queue is NULL. Length of @queue otherwise.
+ */
+int mpmc_queue_length(mpmc_queue_t queue);
+
+#endif /* _MPMC_QUEUE_H */
@@ -0,0 +1,159 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "iqueue.h"
+#include "preempt.h"
+#include "scheduler.h"
+#include "slab.h"
+#include "uthread.h"
+
+/*
+ * A pool runs tasks on a fixed set of threads, which pick them from a FIFO
+ * queue and wait in the idle queue when it is empty. Tasks come out of a slab
+ * of the pool, so that submitting one costs no more than an allocation from
+ * it and a push. Everything is protected by disabling preemption, like the
+ * scheduler.
+ */
+struct uthread_pool {
+	iqueue_t tasks;
+	iqueue_t idle;
+	slab_t taskSlab;
+	bool stopping;
+	int numThreads;
+	uthread_t tids[];
+};
+
+struct uthread_task {
+	iqueue_link_t link;
+	uthread_pool_t pool;
+	uthread_func_t func;
+	void *arg;
+	int retval;
+	bool done;
+	iqueue_t waiter;
+};
+
+/*
+ * body of the threads of the pool @arg: run tasks until
+ * the pool is destroyed and no task is left
+ */
+static int pool_thread(void *arg)
+{
+	uthread_pool_t pool = arg;
+	iqueue_link_t *link;
+
+	preempt_disable();
+	while (1) {
+		link = iqueue_dequeue(&pool->tasks);
+		if (!link) {
+			if (pool->stopping)
+				break;
+			sched_block(&pool->idle);
+			continue;
+		}
+
+		uthread_task_t task = iqueue_entry(link, struct uthread_task, link);
+		preempt_enable();
+		int retval = task->func(task->arg);
+		preempt_disable();
+		task->retval = retval;
+		task->done = true;
+		link = iqueue_dequeue(&task->waiter);
+		if (link)
+			sched_wake(link);
+	}
+	preempt_enable();
+	return 0;
+}
+
+uthread_pool_t uthread_pool_create(int nthreads)
+{
+	if (nthreads <= 0)
+		return NULL;
+
+	uthread_pool_t pool = malloc(sizeof(struct uthread_pool) + nthreads * sizeof(uthread_t));
+	if (!pool)
+		return NULL;
+	pool->taskSlab = slab_create(sizeof(struct uthread_task));
+	if (!pool->taskSlab) {
+		free(pool);
+		return NULL;
+	}
+	iqueue_init(&pool->tasks);
+	iqueue_init(&pool->idle);
+	pool->stopping = false;
+	pool->numThreads = 0;
+
+	for (int i = 0; i < nthreads; ++i) {
+		int tid = uthread_create(pool_thread, pool);
+		if (tid < 0) {
+			uthread_pool_destroy(pool);
+			return NULL;
+		}
+		pool->tids[pool->numThreads++] = tid;
+	}
+	return pool;
+}
+
+int uthread_pool_destroy(uthread_pool_t pool)
+{
+	iqueue_link_t *link;
+
+	if (!pool)
+		return -1;
+
+	preempt_disable();
+	pool->stopping = true;
+	while ((link = iqueue_dequeue(&pool->idle)) != NULL)
+		sched_wake(link);
+	preempt_enable();
+
+	/* the tasks left get run first */
+	for (int i = 0; i < pool->numThreads; ++i)
+		uthread_join(pool->tids[i], NULL);
+	slab_destroy(pool->taskSlab);
+	free(pool);
+	return 0;
+}
+
+uthread_task_t uthread_pool_submit(uthread_pool_t pool, uthread_func_t func, void *arg)
+{
+	if (!pool || !func)
+		return NULL;
+
+	preempt_disable();
+	uthread_task_t task = pool->stopping ? NULL : slab_alloc(pool->taskSlab);
+	if (!task) {
+		preempt_enable();
+		return NULL;
+	}
+	task->pool = pool;
+	task->func = func;
+	task->arg = arg;
+	task->done = false;
+	iqueue_init(&task->waiter);
+	iqueue_enqueue(&pool->tasks, &task->link);
+
+	iqueue_link_t *link = iqueue_dequeue(&pool->idle);
+	if (link)
+		sched_wake(link);
+	preempt_enable();
+	return task;
+}
+
+int uthread_task_wait(uthread_task_t task, int *retval)
+{
+	if (!task)
+		return -1;
+
+	preempt_disable();
+	/* the thread which runs it wakes us up once it is done */
+	if (!task->done)
+		sched_block(&task->waiter);
+	if (retval)
+		*retval = task->retval;
+	slab_free(task->pool->taskSlab, task);
+	preempt_enable();
+	return 0;
+}
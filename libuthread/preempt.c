@@ -1,57 +1,240 @@
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "preempt.h"
 #include "uthread.h"
 
 /*
- * Frequency of preemption
+ * Default frequency of preemption
  * 100Hz is 100 times per second
- * Note: 0.01 second = 10000 microsecond
  */
-#define HZ 100
-#define ELAPSED_TIME 10000
+#define DEFAULT_HZ 100
+#define USEC_PER_SEC 1000000
+#define NSEC_PER_SEC 1000000000L
+
+/* Not defined by every C library */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/*
+ * Every kernel thread running threads has a timer of its
+ * own, which only signals that kernel thread. The timer
+ * only runs while another thread is ready to take the
+ * CPU, and is stopped by the first tick finding nothing
+ * to switch to. A frequency of 0 turns preemption off.
+ * It is only touched with preemption disabled.
+ */
+static __thread struct {
+    unsigned int hz;
+    uthread_preempt_clock_t clock;
+    bool competing;     // another thread is ready
+    bool armed;         // the timer is running
+    bool created;       // timerId exists
+    uthread_preempt_clock_t timerClock; // clock of timerId
+    timer_t timerId;
+} preemptTimer = {DEFAULT_HZ, UTHREAD_PREEMPT_CPU};
+
+/*
+ * Preemption is disabled while disableCount is not zero. A
+ * tick received meanwhile only sets pendingTick, and the
+ * last preempt_enable() accounts it on its behalf, or
+ * yields if a reschedule was asked for in the meantime.
+ * They are only ever touched by the kernel thread owning
+ * them and its signal handler, so no atomic operation is
+ * needed, but the compiler must not move memory accesses
+ * across them.
+ *
+ * When several kernel threads share a scheduler, the
+ * outermost preempt_disable() also takes sharedLock, and
+ * the outermost preempt_enable() releases it.
+ */
+static __thread volatile int disableCount;
+static __thread volatile bool pendingTick;
+static __thread volatile bool pendingResched;
+static __thread pthread_mutex_t *sharedLock;
 
 /*
  * signal handler for SIGVTALRM
  * whenever we receive SIGVTALRM
- * we force the current running thread
- * to yield
+ * we let the scheduler account the tick
+ * to the current running thread, which
+ * may yield, or remember to do it later
  */
 void VTALRM_handler(int signum)
 {
-    uthread_yield();
+    //not sent by our timer, there may be no scheduler here
+    if(!preemptTimer.created)
+        return;
+    if(disableCount){
+        pendingTick = true;
+        return;
+    }
+    pendingTick = false;
+    uthread_tick();
 }
 
 void preempt_disable(void)
 {
-    //uninstall the signal handler
-    struct sigaction new_action;
-    new_action.sa_handler = SIG_IGN;
-    sigfillset(&new_action.sa_mask);
-    sigdelset(&new_action.sa_mask, SIGVTALRM);
-    new_action.sa_flags = 0;
-
-    if(sigaction(SIGVTALRM, &new_action, NULL) < 0)
-        printf("Preempt disable fail.\n");
+    /*
+     * The increment must be a single instruction: if a tick
+     * interrupted it halfway, the handler could yield and
+     * the thread resume on another kernel thread, with
+     * another counter
+     */
+    if(__atomic_add_fetch(&disableCount, 1, __ATOMIC_RELAXED) == 1 && sharedLock)
+        pthread_mutex_lock(sharedLock);
+    atomic_signal_fence(memory_order_seq_cst);
 }
 
 void preempt_enable(void)
 {
-    //reinstall the signal handler
-    struct sigaction new_action;
-    new_action.sa_handler = VTALRM_handler;
-    sigfillset(&new_action.sa_mask);
-    sigdelset(&new_action.sa_mask, SIGVTALRM);
-    new_action.sa_flags = 0;
+    atomic_signal_fence(memory_order_seq_cst);
+    //ticks are still deferred while we unlock
+    if(disableCount == 1 && sharedLock)
+        pthread_mutex_unlock(sharedLock);
+    if(__atomic_sub_fetch(&disableCount, 1, __ATOMIC_RELAXED)
+    || !(pendingTick || pendingResched))
+        return;
+
+    //a forced yield covers the tick as well
+    bool resched = pendingResched;
+    pendingTick = false;
+    pendingResched = false;
+    if(resched)
+        uthread_yield();
+    else
+        uthread_tick();
+}
+
+void preempt_share(pthread_mutex_t *lock)
+{
+    sharedLock = lock;
+}
+
+void preempt_resched(void)
+{
+    pendingResched = true;
+}
+
+void preempt_forget(void)
+{
+    pendingTick = false;
+    pendingResched = false;
+}
 
-    if(sigaction(SIGVTALRM, &new_action, NULL) < 0)
-        printf("Preempt disable fail.\n");
+/*
+ * start (@arm) or stop the timer, the period is a tick
+ */
+static int set_timer(bool arm)
+{
+    long period = arm ? NSEC_PER_SEC / preemptTimer.hz : 0;
+
+    struct itimerspec timer = {};
+    timer.it_interval.tv_sec = period / NSEC_PER_SEC;
+    timer.it_interval.tv_nsec = period % NSEC_PER_SEC;
+    timer.it_value = timer.it_interval;
+    return timer_settime(preemptTimer.timerId, 0, &timer, NULL);
+}
+
+/*
+ * make the timer of the calling kernel thread count
+ * @clock, and send SIGVTALRM to that kernel thread only
+ * CPU time is the one of the kernel thread as well
+ * must be called with the timer stopped
+ */
+static int create_timer(uthread_preempt_clock_t clock)
+{
+    if(preemptTimer.created && preemptTimer.timerClock == clock)
+        return 0;
+
+    struct sigevent event = {};
+    timer_t timerId;
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGVTALRM;
+    event.sigev_notify_thread_id = syscall(SYS_gettid);
+    if(timer_create(clock == UTHREAD_PREEMPT_CPU ? CLOCK_THREAD_CPUTIME_ID : CLOCK_MONOTONIC,
+                    &event, &timerId) < 0)
+        return -1;
+
+    if(preemptTimer.created)
+        timer_delete(preemptTimer.timerId);
+    preemptTimer.timerId = timerId;
+    preemptTimer.timerClock = clock;
+    preemptTimer.created = true;
+    return 0;
+}
+
+void preempt_arm(void)
+{
+    preemptTimer.competing = true;
+    if(preemptTimer.armed || !preemptTimer.hz || !preemptTimer.created)
+        return;
+    if(set_timer(true) < 0)
+        printf("Preempt arm fail.\n");
+    else
+        preemptTimer.armed = true;
+}
+
+void preempt_disarm(void)
+{
+    preemptTimer.competing = false;
+    if(!preemptTimer.armed)
+        return;
+    if(set_timer(false) < 0)
+        printf("Preempt disarm fail.\n");
+    preemptTimer.armed = false;
+}
+
+int uthread_preempt_config(unsigned int hz, uthread_preempt_clock_t clock)
+{
+    if(hz > USEC_PER_SEC
+    || (clock != UTHREAD_PREEMPT_CPU && clock != UTHREAD_PREEMPT_MONOTONIC))
+        return -1;
+
+    preempt_disable();
+
+    //restart the timer with the new settings if it is needed
+    bool competing = preemptTimer.competing;
+    unsigned int oldHz = preemptTimer.hz;
+    preempt_disarm();
+    int ret = 0;
+    if(preemptTimer.created && create_timer(clock) < 0)
+        ret = -1;
+    else{
+        preemptTimer.hz = hz;
+        preemptTimer.clock = clock;
+        //the timer must also accept them once armed
+        if(preemptTimer.created && hz && (set_timer(true) < 0 || set_timer(false) < 0)){
+            preemptTimer.hz = oldHz;
+            ret = -1;
+        }
+    }
+    if(competing)
+        preempt_arm();
+
+    preempt_enable();
+    return ret;
+}
+
+void preempt_get_config(unsigned int *hz, uthread_preempt_clock_t *clock)
+{
+    *hz = preemptTimer.hz;
+    *clock = preemptTimer.clock;
+}
+
+bool preempt_armed(void)
+{
+    return preemptTimer.armed;
 }
 
 void preempt_start(void)
@@ -59,19 +242,28 @@ void preempt_start(void)
 	//install a signal handler
     struct sigaction new_action;
 	new_action.sa_handler = VTALRM_handler;
-	//block every signal except SIGVTALRM
-	sigfillset(&new_action.sa_mask);
-	sigdelset(&new_action.sa_mask, SIGVTALRM);
-	new_action.sa_flags = 0;
-
-    struct itimerval timer = {};
-    timer.it_interval.tv_usec = (long int)ELAPSED_TIME;
-    timer.it_interval.tv_sec = 0;
-    timer.it_value.tv_usec = (long int)ELAPSED_TIME;
-    timer.it_value.tv_sec = 0;
+	/*
+	 * The handler switches to another thread without returning, and the
+	 * native context switch does not restore signal masks. The handler
+	 * must therefore run with the exact mask of the interrupted thread,
+	 * otherwise the next thread would run with signals blocked.
+	 */
+	sigemptyset(&new_action.sa_mask);
+	new_action.sa_flags = SA_NODEFER | SA_RESTART;
 
+	//the timer is only armed once another thread is ready
 	if(sigaction(SIGVTALRM, &new_action, NULL) < 0
-	|| setitimer(ITIMER_VIRTUAL, &timer, NULL) < 0){
+	|| create_timer(preemptTimer.clock) < 0){
 	    printf("Preempt_start fail.\n");
 	}
-}
\ No newline at end of file
+}
+
+void preempt_stop(void)
+{
+    if(!preemptTimer.created)
+        return;
+    preempt_disarm();
+    timer_delete(preemptTimer.timerId);
+    preemptTimer.created = false;
+    sharedLock = NULL;
+}
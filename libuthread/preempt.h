@@ -1,21 +1,120 @@
 #ifndef _PREEMPT_H
 #define _PREEMPT_H
 
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "uthread.h"
+
 /*
- * preempt_start - Start thread preemption
+ * preempt_start - Start thread preemption on the calling kernel thread
  *
- * Configure a timer that must fire a virtual alarm at a frequency of 100 Hz and
- * setup a timer handler that forcefully yields the currently running thread.
+ * Setup a timer handler that forcefully yields the currently running thread,
+ * and create the timer of the calling kernel thread, which only interrupts
+ * that kernel thread. The timer itself is only armed by preempt_arm().
  */
 void preempt_start(void);
 
+/*
+ * preempt_stop - Stop thread preemption on the calling kernel thread
+ *
+ * Delete the timer of the calling kernel thread, and stop sharing critical
+ * sections with other kernel threads. Must be called with preemption enabled.
+ */
+void preempt_stop(void);
+
+/*
+ * preempt_get_config - Get the preemption settings of the calling kernel thread
+ * @hz: Receives the number of time slices per second
+ * @clock: Receives the clock measuring them
+ *
+ * Settings are made per kernel thread by uthread_preempt_config(), this is how
+ * a new kernel thread gets the settings of the one starting it.
+ */
+void preempt_get_config(unsigned int *hz, uthread_preempt_clock_t *clock);
+
+/*
+ * preempt_armed - Whether the timer of the calling kernel thread is running
+ */
+bool preempt_armed(void);
+
+/*
+ * preempt_arm - Signal that another thread is ready to run
+ *
+ * Arm the timer of the calling kernel thread, at the frequency and on the clock
+ * set by uthread_preempt_config(), unless it is already running. Must be called
+ * with preemption disabled.
+ */
+void preempt_arm(void);
+
+/*
+ * preempt_disarm - Signal that no other thread is ready to run
+ *
+ * Stop the timer if it is running, so that a lone thread does not receive
+ * useless signals. Must be called with preemption disabled.
+ */
+void preempt_disarm(void);
+
 /*
  * preempt_enable - Enable preemption
+ *
+ * Undo one call to preempt_disable(). When preemption becomes enabled again,
+ * perform what was deferred while it was disabled: account a timer tick, or
+ * yield after preempt_resched().
  */
 void preempt_enable(void);
 
+/*
+ * preempt_share - Make critical sections exclusive across kernel threads
+ * @lock: Lock to hold while preemption is disabled
+ *
+ * Preemption is disabled separately on each kernel thread. Once this function
+ * has been called on a kernel thread, disabling preemption there also takes
+ * @lock, so that a scheduler can be shared between the kernel threads calling
+ * it with the same @lock. A thread switches to another thread with @lock held,
+ * and the thread it switches to releases it. Must be called with preemption
+ * enabled.
+ */
+void preempt_share(pthread_mutex_t *lock);
+
+/*
+ * preempt_resched - Yield as soon as preemption is enabled
+ *
+ * Used when a thread more urgent than the running one becomes ready. Must be
+ * called with preemption disabled, the running thread then yields when the
+ * outermost preempt_enable() is called.
+ */
+void preempt_resched(void);
+
+/*
+ * preempt_forget - Drop the deferred tick and reschedule
+ *
+ * Called when the calling kernel thread switches to another thread, with a
+ * fresh time slice: a tick received or a reschedule asked for before the switch
+ * was meant for the thread switched out, and must not be charged to the new
+ * one. Must be called with preemption disabled.
+ */
+void preempt_forget(void);
+
+/*
+ * uthread_tick - Account a timer tick to the running thread
+ *
+ * Implemented by the scheduler, and called with preemption enabled for every
+ * timer tick, possibly deferred until preemption was enabled. The running
+ * thread yields once it has used up its time slice.
+ */
+void uthread_tick(void);
+
 /*
  * preempt_disable - Disable preemption
+ *
+ * Calls nest: preemption stays disabled until preempt_enable() has been called
+ * as many times as preempt_disable(). This neither makes a system call nor
+ * blocks the timer signal, ticks received meanwhile are deferred instead.
+ *
+ * A thread switches to another thread with preemption disabled exactly once,
+ * and the thread it switches to enables it back. Preemption is disabled
+ * separately on each kernel thread.
  */
 void preempt_disable(void);
 
@@ -17,9 +17,20 @@ struct node {
     struct node *next;
 };
 
+/*
+ * The ring backend stores items in a power-of-two array
+ * used as a circular buffer. head is the index of the
+ * oldest element, and the buffer doubles when full.
+ */
+#define RING_INITIAL_CAPACITY 16
+
 struct queue {
+    queue_type_t type;
 	struct node *header;
     struct node *tail;
+    void **buffer;
+    unsigned int capacity;
+    unsigned int head;
     int numOfElement; // convenient to keep track the size of queue
 };
 
@@ -28,13 +39,24 @@ struct queue {
  */
 queue_t queue_create(void)
 {
+    return queue_create_type(QUEUE_LIST);
+}
+
+queue_t queue_create_type(queue_type_t type)
+{
+    if(type != QUEUE_LIST && type != QUEUE_RING)
+        return NULL;
     queue_t myQueue = malloc(sizeof(struct queue));
     if(!myQueue){
         perror("malloc");
         return NULL;
     }
+    myQueue->type = type;
 	myQueue->header = NULL;
 	myQueue->tail = NULL;
+    myQueue->buffer = NULL;
+    myQueue->capacity = 0;
+    myQueue->head = 0;
 	myQueue->numOfElement = 0;
 	return myQueue;
 }
@@ -48,10 +70,70 @@ int queue_destroy(queue_t queue)
 {
     if(!queue || queue->numOfElement > 0)
         return -1;
+    free(queue->buffer);
     free(queue);
     return 0;
 }
 
+/*
+ * address of the @i-th oldest element of a ring queue
+ */
+static void **ring_slot(queue_t queue, int i)
+{
+    return &queue->buffer[(queue->head + i) & (queue->capacity - 1)];
+}
+
+/*
+ * make sure a ring queue can hold @count elements
+ * growing straightens the buffer, so that the oldest
+ * element is at index 0 again
+ */
+static int ring_reserve(queue_t queue, int count)
+{
+    if(count <= queue->capacity)
+        return 0;
+
+    unsigned int capacity = queue->capacity ? queue->capacity : RING_INITIAL_CAPACITY;
+    while(capacity < count)
+        capacity *= 2;
+    void **buffer = malloc(capacity * sizeof(void*));
+    if(!buffer){
+        perror("malloc");
+        return -1;
+    }
+    for (int i = 0; i < queue->numOfElement; ++i)
+        buffer[i] = *ring_slot(queue, i);
+    free(queue->buffer);
+    queue->buffer = buffer;
+    queue->capacity = capacity;
+    queue->head = 0;
+    return 0;
+}
+
+/*
+ * copy @count elements from @data into a ring queue,
+ * starting at the @first-th slot, in at most two runs
+ * (before and after the end of the buffer)
+ */
+static void ring_copy_in(queue_t queue, int first, void **data, int count)
+{
+    unsigned int start = (queue->head + first) & (queue->capacity - 1);
+    unsigned int run = queue->capacity - start;
+    if(run > count)
+        run = count;
+    memcpy(&queue->buffer[start], data, run * sizeof(void*));
+    memcpy(queue->buffer, data + run, (count - run) * sizeof(void*));
+}
+
+static void ring_copy_out(queue_t queue, void **data, int count)
+{
+    unsigned int run = queue->capacity - queue->head;
+    if(run > count)
+        run = count;
+    memcpy(data, &queue->buffer[queue->head], run * sizeof(void*));
+    memcpy(data + run, queue->buffer, (count - run) * sizeof(void*));
+}
+
 /*
  * if queue is empty, we do not need to malloc
  * new memory. if it is not, we create a new node
@@ -64,6 +146,14 @@ int queue_enqueue(queue_t queue, void *data)
     if(!queue || !data)
         return -1;
 
+    if(queue->type == QUEUE_RING){
+        if(ring_reserve(queue, queue->numOfElement + 1))
+            return -1;
+        *ring_slot(queue, queue->numOfElement) = data;
+        ++(queue->numOfElement);
+        return 0;
+    }
+
     struct node *newNode = malloc(sizeof(struct node));
     if(!newNode) {
         perror("malloc");
@@ -99,6 +189,13 @@ int queue_dequeue(queue_t queue, void **data)
 	if(!queue || !data || queue->numOfElement == 0)
 	    return -1;
 
+    if(queue->type == QUEUE_RING){
+        *data = *ring_slot(queue, 0);
+        queue->head = (queue->head + 1) & (queue->capacity - 1);
+        --(queue->numOfElement);
+        return 0;
+    }
+
 	*data = queue->header->data;
 	struct node *tmp = queue->header;
 	queue->header = queue->header->next;
@@ -116,8 +213,22 @@ int queue_dequeue(queue_t queue, void **data)
  */
 int queue_delete(queue_t queue, void *data)
 {
-    if(!queue || !data)
+    if(!queue || !data || queue->numOfElement == 0)
+        return -1;
+
+    if(queue->type == QUEUE_RING){
+        for (int i = 0; i < queue->numOfElement; ++i) {
+            if(*ring_slot(queue, i) != data)
+                continue;
+            //close the gap by moving the newer elements down
+            for (int j = i + 1; j < queue->numOfElement; ++j)
+                *ring_slot(queue, j - 1) = *ring_slot(queue, j);
+            --(queue->numOfElement);
+            return 0;
+        }
         return -1;
+    }
+
     //if what we find is header
     if(queue->header->data == data){
         queue_dequeue(queue, &data);
@@ -147,6 +258,19 @@ int queue_iterate(queue_t queue, queue_func_t func, void *arg, void **data)
 {
 	if(!queue || !func)
 	    return -1;
+
+    if(queue->type == QUEUE_RING){
+        for (int i = 0; i < queue->numOfElement; ++i) {
+            void *item = *ring_slot(queue, i);
+            if((*func)(item, arg) == 0)
+                continue;
+            if(data != NULL)
+                *data = item;
+            return 0;
+        }
+        return 0;
+    }
+
     for (struct node *it = queue->header; it != NULL ; it = it->next) {
         int returnVal = (*func)(it->data, arg);
         if(returnVal == 0)
@@ -167,3 +291,74 @@ int queue_length(queue_t queue)
 	return queue->numOfElement;
 }
 
+/*
+ * enqueue all of @data or nothing
+ * the ring backend makes room once and copies the
+ * whole batch, the list backend links the nodes of
+ * the batch together before appending them
+ */
+int queue_enqueue_batch(queue_t queue, void **data, int count)
+{
+    if(!queue || !data || count < 0)
+        return -1;
+    for (int i = 0; i < count; ++i)
+        if(!data[i])
+            return -1;
+    if(count == 0)
+        return 0;
+
+    if(queue->type == QUEUE_RING){
+        if(ring_reserve(queue, queue->numOfElement + count))
+            return -1;
+        ring_copy_in(queue, queue->numOfElement, data, count);
+        queue->numOfElement += count;
+        return 0;
+    }
+
+    struct node *first = NULL, *last = NULL;
+    for (int i = 0; i < count; ++i) {
+        struct node *newNode = malloc(sizeof(struct node));
+        if(!newNode) {
+            perror("malloc");
+            while(first){
+                struct node *tmp = first;
+                first = first->next;
+                free(tmp);
+            }
+            return -1;
+        }
+        newNode->data = data[i];
+        newNode->next = NULL;
+        if(last)
+            last->next = newNode;
+        else
+            first = newNode;
+        last = newNode;
+    }
+    if(queue->numOfElement == 0)
+        queue->header = first;
+    else
+        queue->tail->next = first;
+    queue->tail = last;
+    queue->numOfElement += count;
+    return 0;
+}
+
+int queue_dequeue_batch(queue_t queue, void **data, int count)
+{
+    if(!queue || !data || count < 0)
+        return -1;
+    if(count > queue->numOfElement)
+        count = queue->numOfElement;
+
+    if(queue->type == QUEUE_RING){
+        ring_copy_out(queue, data, count);
+        queue->head = (queue->head + count) & (queue->capacity - 1);
+        queue->numOfElement -= count;
+        return count;
+    }
+
+    for (int i = 0; i < count; ++i)
+        queue_dequeue(queue, &data[i]);
+    return count;
+}
@@ -12,16 +12,40 @@
  */
 typedef struct queue* queue_t;
 
+/*
+ * queue_type_t - Queue implementation
+ * @QUEUE_LIST: Linked list of nodes, one allocation per enqueued item
+ * @QUEUE_RING: Growable power-of-two ring buffer, items stored contiguously
+ *
+ * Both implementations follow the exact same contract. The ring buffer only
+ * allocates when it needs to grow and is much friendlier to caches and
+ * prefetchers, but its delete operation has to move the newer items.
+ */
+typedef enum queue_type {
+	QUEUE_LIST,
+	QUEUE_RING,
+} queue_type_t;
+
 /*
  * queue_create - Allocate an empty queue
  *
- * Create a new object of type 'struct queue' and return its address.
+ * Create a new object of type 'struct queue' and return its address. The
+ * queue is a QUEUE_LIST.
  *
  * Return: Pointer to new empty queue. NULL in case of failure when allocating
  * the new queue.
  */
 queue_t queue_create(void);
 
+/*
+ * queue_create_type - Allocate an empty queue of a given implementation
+ * @type: Implementation of the queue
+ *
+ * Return: Pointer to new empty queue. NULL if @type is invalid or in case of
+ * failure when allocating the new queue.
+ */
+queue_t queue_create_type(queue_type_t type);
+
 /*
  * queue_destroy - Deallocate a queue
  * @queue: Queue to deallocate
@@ -58,6 +82,37 @@ int queue_enqueue(queue_t queue, void *data);
  */
 int queue_dequeue(queue_t queue, void **data);
 
+/*
+ * queue_enqueue_batch - Enqueue several data items
+ * @queue: Queue in which to enqueue items
+ * @data: Array of the addresses to enqueue
+ * @count: Number of items in @data
+ *
+ * Enqueue the @count addresses of @data in the queue @queue, in order, as if
+ * queue_enqueue() was called on each of them. Either all the items are
+ * enqueued, or none of them is.
+ *
+ * Return: -1 if @queue or @data are NULL, if @count is negative, if one of the
+ * items is NULL, or in case of memory allocation error. 0 if all the items were
+ * successfully enqueued in @queue.
+ */
+int queue_enqueue_batch(queue_t queue, void **data, int count);
+
+/*
+ * queue_dequeue_batch - Dequeue several data items
+ * @queue: Queue in which to dequeue items
+ * @data: Array receiving the items
+ * @count: Maximum number of items to dequeue
+ *
+ * Remove up to @count of the oldest items of queue @queue and store them in
+ * @data, oldest first.
+ *
+ * Return: -1 if @queue or @data are NULL, or if @count is negative. The number
+ * of items dequeued otherwise, which is less than @count only if the queue ran
+ * out of items.
+ */
+int queue_dequeue_batch(queue_t queue, void **data, int count);
+
 /*
  * queue_delete - Delete data item
  * @queue: Queue in which to delete item
@@ -0,0 +1,264 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+/*
+ * A missing child is a black leaf. The tree keeps the usual
+ * invariants: a red node has no red child, and every path
+ * from a node down to a leaf goes through the same number
+ * of black nodes, hence a height of at most 2 log(n + 1).
+ */
+static bool is_red(rbtree_node_t *node)
+{
+	return node && node->red;
+}
+
+/*
+ * make @new take the place of @old as a child of @parent
+ */
+static void replace_child(rbtree_t *tree, rbtree_node_t *parent,
+			  rbtree_node_t *old, rbtree_node_t *new)
+{
+	if (!parent)
+		tree->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+static void rotate_left(rbtree_t *tree, rbtree_node_t *node)
+{
+	rbtree_node_t *right = node->right;
+
+	node->right = right->left;
+	if (right->left)
+		right->left->parent = node;
+	right->parent = node->parent;
+	replace_child(tree, node->parent, node, right);
+	right->left = node;
+	node->parent = right;
+}
+
+static void rotate_right(rbtree_t *tree, rbtree_node_t *node)
+{
+	rbtree_node_t *left = node->left;
+
+	node->left = left->right;
+	if (left->right)
+		left->right->parent = node;
+	left->parent = node->parent;
+	replace_child(tree, node->parent, node, left);
+	left->right = node;
+	node->parent = left;
+}
+
+rbtree_node_t *rbtree_next(rbtree_node_t *node)
+{
+	if (node->right) {
+		node = node->right;
+		while (node->left)
+			node = node->left;
+		return node;
+	}
+	while (node->parent && node == node->parent->right)
+		node = node->parent;
+	return node->parent;
+}
+
+/*
+ * restore the invariants after red @node was inserted
+ */
+static void insert_fixup(rbtree_t *tree, rbtree_node_t *node)
+{
+	rbtree_node_t *parent;
+
+	while ((parent = node->parent) && parent->red) {
+		/* A red parent is never the root */
+		rbtree_node_t *grandparent = parent->parent;
+
+		if (parent == grandparent->left) {
+			rbtree_node_t *uncle = grandparent->right;
+
+			if (is_red(uncle)) {
+				parent->red = false;
+				uncle->red = false;
+				grandparent->red = true;
+				node = grandparent;
+				continue;
+			}
+			if (node == parent->right) {
+				rotate_left(tree, parent);
+				node = parent;
+				parent = node->parent;
+			}
+			parent->red = false;
+			grandparent->red = true;
+			rotate_right(tree, grandparent);
+		} else {
+			rbtree_node_t *uncle = grandparent->left;
+
+			if (is_red(uncle)) {
+				parent->red = false;
+				uncle->red = false;
+				grandparent->red = true;
+				node = grandparent;
+				continue;
+			}
+			if (node == parent->left) {
+				rotate_right(tree, parent);
+				node = parent;
+				parent = node->parent;
+			}
+			parent->red = false;
+			grandparent->red = true;
+			rotate_left(tree, grandparent);
+		}
+	}
+	tree->root->red = false;
+}
+
+void rbtree_insert(rbtree_t *tree, rbtree_node_t *node, rbtree_less_t less)
+{
+	rbtree_node_t **link = &tree->root;
+	rbtree_node_t *parent = NULL;
+	bool leftmost = true;
+
+	/* Equal keys go right, so that they stay in insertion order */
+	while (*link) {
+		parent = *link;
+		if (less(node, parent)) {
+			link = &parent->left;
+		} else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	node->parent = parent;
+	node->left = NULL;
+	node->right = NULL;
+	node->red = true;
+	*link = node;
+	if (leftmost)
+		tree->first = node;
+	tree->count++;
+
+	insert_fixup(tree, node);
+}
+
+/*
+ * restore the invariants after a black node was removed
+ * from above @node, which may be a leaf: hence @parent
+ */
+static void remove_fixup(rbtree_t *tree, rbtree_node_t *node,
+			 rbtree_node_t *parent)
+{
+	while (node != tree->root && !is_red(node)) {
+		/*
+		 * The path through @node lacks a black node, so its
+		 * sibling cannot be a leaf
+		 */
+		if (node == parent->left) {
+			rbtree_node_t *sibling = parent->right;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left(tree, parent);
+				sibling = parent->right;
+			}
+			if (!is_red(sibling->left) && !is_red(sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+			if (!is_red(sibling->right)) {
+				sibling->left->red = false;
+				sibling->red = true;
+				rotate_right(tree, sibling);
+				sibling = parent->right;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->right->red = false;
+			rotate_left(tree, parent);
+		} else {
+			rbtree_node_t *sibling = parent->left;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right(tree, parent);
+				sibling = parent->left;
+			}
+			if (!is_red(sibling->left) && !is_red(sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+			if (!is_red(sibling->left)) {
+				sibling->right->red = false;
+				sibling->red = true;
+				rotate_left(tree, sibling);
+				sibling = parent->left;
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->left->red = false;
+			rotate_right(tree, parent);
+		}
+		node = tree->root;
+	}
+	if (node)
+		node->red = false;
+}
+
+void rbtree_remove(rbtree_t *tree, rbtree_node_t *node)
+{
+	rbtree_node_t *child, *parent;
+	bool removedRed;
+
+	if (tree->first == node)
+		tree->first = rbtree_next(node);
+	tree->count--;
+
+	if (!node->left || !node->right) {
+		/* Splice @node out */
+		child = node->left ? node->left : node->right;
+		parent = node->parent;
+		removedRed = node->red;
+		if (child)
+			child->parent = parent;
+		replace_child(tree, parent, node, child);
+	} else {
+		/* Move @node's successor, which has no left child, in its place */
+		rbtree_node_t *successor = node->right;
+
+		while (successor->left)
+			successor = successor->left;
+		removedRed = successor->red;
+		child = successor->right;
+		if (successor->parent == node) {
+			parent = successor;
+		} else {
+			parent = successor->parent;
+			parent->left = child;
+			if (child)
+				child->parent = parent;
+			successor->right = node->right;
+			node->right->parent = successor;
+		}
+		successor->left = node->left;
+		node->left->parent = successor;
+		successor->parent = node->parent;
+		replace_child(tree, node->parent, node, successor);
+		successor->red = node->red;
+	}
+
+	if (!removedRed)
+		remove_fixup(tree, child, parent);
+}
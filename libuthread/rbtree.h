@@ -0,0 +1,106 @@
+#ifndef _RBTREE_H
+#define _RBTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * rbtree_t - Intrusive red-black tree type
+ *
+ * An intrusive red-black tree keeps items sorted by a key of their own, and the
+ * items embed their node (rbtree_node_t) rather than being wrapped in a node
+ * allocated by the tree, so no operation ever allocates memory. Items with
+ * equal keys are kept in insertion order.
+ *
+ * Inserting and removing an item are O(log n), and getting the smallest item
+ * is O(1). An item can only be in one tree at a time through a given node.
+ */
+typedef struct rbtree_node {
+	struct rbtree_node *parent;
+	struct rbtree_node *left;
+	struct rbtree_node *right;
+	bool red;
+} rbtree_node_t;
+
+typedef struct rbtree {
+	rbtree_node_t *root;
+	rbtree_node_t *first;
+	int count;
+} rbtree_t;
+
+/*
+ * rbtree_less_t - Item comparison function type
+ * @a: Node of the first item
+ * @b: Node of the second item
+ *
+ * Return: true if the key of @a is strictly smaller than the key of @b
+ */
+typedef bool (*rbtree_less_t)(const rbtree_node_t *a, const rbtree_node_t *b);
+
+/*
+ * rbtree_entry - Get the item embedding a node
+ * @node: Address of the node
+ * @type: Type of the item
+ * @member: Name of the node member in @type
+ */
+#define rbtree_entry(node, type, member) \
+	((type *)((char *)(node) - offsetof(type, member)))
+
+/*
+ * rbtree_init - Initialize an empty tree
+ * @tree: Tree to initialize
+ */
+static inline void rbtree_init(rbtree_t *tree)
+{
+	tree->root = NULL;
+	tree->first = NULL;
+	tree->count = 0;
+}
+
+/*
+ * rbtree_count - Number of items in a tree
+ * @tree: Tree to count the items of
+ */
+static inline int rbtree_count(rbtree_t *tree)
+{
+	return tree->count;
+}
+
+/*
+ * rbtree_first - Get the smallest item
+ * @tree: Tree to look into
+ *
+ * Return: Node of the item with the smallest key, the oldest one if several
+ * items have that key. NULL if the tree is empty.
+ */
+static inline rbtree_node_t *rbtree_first(rbtree_t *tree)
+{
+	return tree->first;
+}
+
+/*
+ * rbtree_next - Get the next item in key order
+ * @node: Node of an item in a tree
+ *
+ * Return: Node of the item following @node, NULL if @node is the last one
+ */
+rbtree_node_t *rbtree_next(rbtree_node_t *node);
+
+/*
+ * rbtree_insert - Insert an item
+ * @tree: Tree in which to insert the item
+ * @node: Node of the item to insert
+ * @less: Comparison function of the items of @tree
+ *
+ * The item is placed after all the items of the same key.
+ */
+void rbtree_insert(rbtree_t *tree, rbtree_node_t *node, rbtree_less_t less);
+
+/*
+ * rbtree_remove - Remove an item
+ * @tree: Tree in which the item is
+ * @node: Node of the item to remove
+ */
+void rbtree_remove(rbtree_t *tree, rbtree_node_t *node);
+
+#endif /* _RBTREE_H */
@@ -0,0 +1,57 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <stdbool.h>
+
+#include "iqueue.h"
+
+/*
+ * Blocking for the synchronization objects built on top of the scheduler. A
+ * blocked thread waits in the wait queue of an object, linked through its
+ * control block, so it costs no allocation and its stack may be saved away
+ * meanwhile. The queues are protected by disabling preemption, like the rest
+ * of the scheduler: an object can only be used by the threads of a single
+ * scheduler.
+ */
+
+/*
+ * sched_block - Block the running thread in a wait queue
+ * @queue: Queue to wait in
+ *
+ * The running thread is enqueued at the tail of @queue and switches to another
+ * thread. This returns once the thread has been removed from @queue and made
+ * ready again with sched_wake(). Must be called with preemption disabled, and
+ * returns with preemption still disabled.
+ */
+void sched_block(iqueue_t *queue);
+
+/*
+ * sched_wake - Make a blocked thread ready
+ * @link: Link of the thread, which has been removed from its wait queue
+ *
+ * The thread runs right away if it is more urgent than the running thread.
+ * Must be called with preemption disabled.
+ */
+void sched_wake(iqueue_link_t *link);
+
+/*
+ * sched_handoff - Make a blocked thread ready, and switch to it
+ * @link: Link of the thread, which has been removed from its wait queue
+ *
+ * The running thread stays ready, and the thread it passes the CPU to takes
+ * the data it was waiting for while it is still hot in the cache. This is the
+ * same as sched_wake() if the thread is less urgent than the running thread,
+ * or if it cannot run on this worker. Must be called with preemption disabled,
+ * and returns with preemption still disabled.
+ */
+void sched_handoff(iqueue_link_t *link);
+
+/*
+ * sched_shared_stack - Whether the running thread is on the shared stack
+ *
+ * The stack of such a thread may be saved away while it is blocked, so other
+ * threads must not access anything on it meanwhile.
+ */
+bool sched_shared_stack(void);
+
+#endif /* _SCHEDULER_H */
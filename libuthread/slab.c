@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "slab.h"
+
+/* Size of the chunks objects are carved out of (in bytes) */
+#define SLAB_CHUNK_SIZE 65536
+
+/*
+ * Each chunk starts with a header linking it to the other chunks of the
+ * slab (the header takes one cache line). Free objects are linked together
+ * through their own memory.
+ */
+struct chunk {
+    struct chunk *next;
+};
+
+struct free_object {
+    struct free_object *next;
+};
+
+struct slab {
+    size_t objectSize;
+    struct chunk *chunks;
+    struct free_object *freeList;
+};
+
+slab_t slab_create(size_t size)
+{
+    if(size == 0)
+        return NULL;
+
+    slab_t slab = malloc(sizeof(struct slab));
+    if(!slab){
+        perror("malloc");
+        return NULL;
+    }
+    //round up, so every object is aligned on a cache line
+    slab->objectSize = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    slab->chunks = NULL;
+    slab->freeList = NULL;
+    return slab;
+}
+
+int slab_destroy(slab_t slab)
+{
+    if(!slab)
+        return -1;
+    while(slab->chunks){
+        struct chunk *tmp = slab->chunks;
+        slab->chunks = tmp->next;
+        free(tmp);
+    }
+    free(slab);
+    return 0;
+}
+
+/*
+ * allocate a new chunk and put all its
+ * objects on the free list
+ */
+static int slab_grow(slab_t slab)
+{
+    size_t chunkSize = SLAB_CHUNK_SIZE;
+    //a chunk holds at least one object
+    if(chunkSize < CACHE_LINE_SIZE + slab->objectSize)
+        chunkSize = CACHE_LINE_SIZE + slab->objectSize;
+
+    struct chunk *chunk;
+    if(posix_memalign((void**)&chunk, CACHE_LINE_SIZE, chunkSize)){
+        perror("posix_memalign");
+        return -1;
+    }
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    //push from the end, so objects are handed out in address order
+    size_t numObjects = (chunkSize - CACHE_LINE_SIZE) / slab->objectSize;
+    char *first = (char*)chunk + CACHE_LINE_SIZE;
+    for (size_t i = numObjects; i > 0; --i) {
+        struct free_object *freeObj = (struct free_object*)(first + (i - 1) * slab->objectSize);
+        freeObj->next = slab->freeList;
+        slab->freeList = freeObj;
+    }
+    return 0;
+}
+
+void *slab_alloc(slab_t slab)
+{
+    if(!slab)
+        return NULL;
+    if(!slab->freeList && slab_grow(slab))
+        return NULL;
+
+    struct free_object *obj = slab->freeList;
+    slab->freeList = obj->next;
+    return obj;
+}
+
+int slab_free(slab_t slab, void *obj)
+{
+    if(!slab || !obj)
+        return -1;
+
+    struct free_object *freeObj = obj;
+    freeObj->next = slab->freeList;
+    slab->freeList = freeObj;
+    return 0;
+}
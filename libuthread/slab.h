@@ -0,0 +1,65 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stddef.h>
+
+/*
+ * CACHE_LINE_SIZE - Size of a cache line (in bytes)
+ */
+#define CACHE_LINE_SIZE 64
+
+/*
+ * slab_t - Object cache type
+ *
+ * A slab hands out objects of one fixed size. Objects are carved out of large
+ * chunks of memory and are aligned on a cache line, and freed objects are kept
+ * on a free list to be handed out again. Apart from growing by one chunk when
+ * the free list is empty, allocation and release are O(1) and never call into
+ * the system allocator.
+ *
+ * A slab is not protected against preemption: once threads are running, it
+ * must only be used with preemption disabled.
+ */
+typedef struct slab* slab_t;
+
+/*
+ * slab_create - Allocate an empty slab
+ * @size: Size of the objects (in bytes)
+ *
+ * Return: Pointer to new slab. NULL in case of failure when allocating the
+ * slab, or if @size is 0.
+ */
+slab_t slab_create(size_t size);
+
+/*
+ * slab_destroy - Deallocate a slab
+ * @slab: Slab to deallocate
+ *
+ * Release all the memory of slab @slab, including the objects which were not
+ * freed.
+ *
+ * Return: -1 if @slab is NULL, 0 otherwise.
+ */
+int slab_destroy(slab_t slab);
+
+/*
+ * slab_alloc - Allocate an object
+ * @slab: Slab to allocate from
+ *
+ * The content of the object is undefined.
+ *
+ * Return: Pointer to the object, or NULL if @slab is NULL or in case of memory
+ * allocation error.
+ */
+void *slab_alloc(slab_t slab);
+
+/*
+ * slab_free - Release an object
+ * @slab: Slab @obj was allocated from
+ * @obj: Object to release
+ *
+ * Return: -1 if @slab or @obj are NULL, 0 otherwise.
+ */
+int slab_free(slab_t slab, void *obj);
+
+#endif /* _SLAB_H */
@@ -0,0 +1,202 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "iqueue.h"
+#include "preempt.h"
+#include "scheduler.h"
+#include "uthread.h"
+
+/*
+ * A mutex is unlocked, locked, or locked with threads in its wait queue. Only
+ * the first two states are used by the fast paths, which just flip between
+ * them. Entering and leaving the contended state, as well as the wait queue,
+ * only happen with preemption disabled, so that a thread seeing the contended
+ * state with preemption disabled knows that waiters are queued.
+ *
+ * The state of a mutex and the count of a semaphore are plain ints, so that
+ * uthread.h does not need <stdatomic.h>, always accessed with the atomic
+ * builtins.
+ */
+enum {
+	MUTEX_UNLOCKED,
+	MUTEX_LOCKED,
+	MUTEX_CONTENDED,
+};
+
+void uthread_mutex_init(uthread_mutex_t *mutex)
+{
+	mutex->state = MUTEX_UNLOCKED;
+	iqueue_init(&mutex->waiters);
+}
+
+/*
+ * lock @mutex if it is free, or mark it contended
+ * must be called with preemption disabled
+ * Return value:
+ * true if the mutex was locked
+ */
+static bool mutex_acquire_or_contend(uthread_mutex_t *mutex)
+{
+	int state = __atomic_load_n(&mutex->state, __ATOMIC_SEQ_CST);
+
+	while (state != MUTEX_CONTENDED) {
+		int next = state == MUTEX_UNLOCKED ? MUTEX_LOCKED : MUTEX_CONTENDED;
+		if (__atomic_compare_exchange_n(&mutex->state, &state, next, true,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			return state == MUTEX_UNLOCKED;
+	}
+	return false;
+}
+
+void uthread_mutex_lock(uthread_mutex_t *mutex)
+{
+	int state = MUTEX_UNLOCKED;
+
+	if (__atomic_compare_exchange_n(&mutex->state, &state, MUTEX_LOCKED, false,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	preempt_disable();
+	/* the unlocking thread hands the mutex over to us */
+	if (!mutex_acquire_or_contend(mutex))
+		sched_block(&mutex->waiters);
+	preempt_enable();
+}
+
+int uthread_mutex_trylock(uthread_mutex_t *mutex)
+{
+	int state = MUTEX_UNLOCKED;
+
+	if (__atomic_compare_exchange_n(&mutex->state, &state, MUTEX_LOCKED, false,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return 0;
+	return -1;
+}
+
+void uthread_mutex_unlock(uthread_mutex_t *mutex)
+{
+	int state = MUTEX_LOCKED;
+
+	if (__atomic_compare_exchange_n(&mutex->state, &state, MUTEX_UNLOCKED, false,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		return;
+
+	preempt_disable();
+	iqueue_link_t *link = iqueue_dequeue(&mutex->waiters);
+	/* still locked, by the oldest waiter now */
+	if (!iqueue_length(&mutex->waiters))
+		__atomic_store_n(&mutex->state, link ? MUTEX_LOCKED : MUTEX_UNLOCKED,
+				 __ATOMIC_SEQ_CST);
+	if (link)
+		sched_wake(link);
+	preempt_enable();
+}
+
+void uthread_cond_init(uthread_cond_t *cond)
+{
+	iqueue_init(&cond->waiters);
+	cond->mutex = NULL;
+}
+
+void uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex)
+{
+	/* nobody can signal between the unlock and the moment we block */
+	preempt_disable();
+	cond->mutex = mutex;
+	uthread_mutex_unlock(mutex);
+	/* we own the mutex again when we are woken up */
+	sched_block(&cond->waiters);
+	preempt_enable();
+}
+
+/*
+ * give the waiter of @cond at @link the mutex, or queue
+ * it on the mutex if it is locked
+ * must be called with preemption disabled
+ */
+static void cond_requeue(uthread_cond_t *cond, iqueue_link_t *link)
+{
+	if (mutex_acquire_or_contend(cond->mutex))
+		sched_wake(link);
+	else
+		iqueue_enqueue(&cond->mutex->waiters, link);
+}
+
+void uthread_cond_signal(uthread_cond_t *cond)
+{
+	preempt_disable();
+	iqueue_link_t *link = iqueue_dequeue(&cond->waiters);
+	if (link)
+		cond_requeue(cond, link);
+	preempt_enable();
+}
+
+void uthread_cond_broadcast(uthread_cond_t *cond)
+{
+	iqueue_link_t *link;
+
+	preempt_disable();
+	while ((link = iqueue_dequeue(&cond->waiters)) != NULL)
+		cond_requeue(cond, link);
+	preempt_enable();
+}
+
+int uthread_sem_init(uthread_sem_t *sem, int count)
+{
+	if (count < 0)
+		return -1;
+	sem->count = count;
+	iqueue_init(&sem->waiters);
+	sem->handoffs = 0;
+	return 0;
+}
+
+/*
+ * A thread which finds no resource counts itself as a waiter right away, but
+ * only gets into the wait queue once preemption is disabled. A resource
+ * released in between is kept in handoffs for it.
+ */
+void uthread_sem_down(uthread_sem_t *sem)
+{
+	if (__atomic_fetch_sub(&sem->count, 1, __ATOMIC_ACQUIRE) > 0)
+		return;
+
+	preempt_disable();
+	if (sem->handoffs)
+		sem->handoffs--;
+	else
+		sched_block(&sem->waiters);
+	preempt_enable();
+}
+
+int uthread_sem_trydown(uthread_sem_t *sem)
+{
+	int count = __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+
+	while (count > 0) {
+		if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, true,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return 0;
+	}
+	return -1;
+}
+
+void uthread_sem_up(uthread_sem_t *sem)
+{
+	if (__atomic_fetch_add(&sem->count, 1, __ATOMIC_RELEASE) >= 0)
+		return;
+
+	preempt_disable();
+	iqueue_link_t *link = iqueue_dequeue(&sem->waiters);
+	if (link)
+		sched_wake(link);
+	else
+		sem->handoffs++;
+	preempt_enable();
+}
+
+int uthread_sem_getvalue(uthread_sem_t *sem)
+{
+	int count = __atomic_load_n(&sem->count, __ATOMIC_SEQ_CST);
+	return count > 0 ? count : 0;
+}
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_TICK (UINT64_MAX >> TIMER_WHEEL_TICK_SHIFT)
+
+/*
+ * A timer of level l and slot s expires on a tick whose digits (groups of
+ * TIMER_WHEEL_SLOT_BITS bits) above l are those of the tick it was placed
+ * from, and whose digit l is s, greater than the digit l of that tick. It is
+ * due when the current tick reaches digit s on level l, with all the lower
+ * digits at 0: it then moves to a lower level, or expires if it is on the
+ * first one. Whatever the current tick, the slot of its own digit is
+ * therefore empty on every level.
+ */
+static int digit(uint64_t tick, int level)
+{
+	return (tick >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+}
+
+/*
+ * put @timer, which expires no earlier than @base, in
+ * its slot as seen from @base
+ */
+static void place_timer(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t base)
+{
+	uint64_t diff = timer->expires ^ base;
+	int level = diff ? (63 - __builtin_clzll(diff)) / TIMER_WHEEL_SLOT_BITS : 0;
+	int index = digit(timer->expires, level);
+
+	timer->slot = &wheel->slots[level][index];
+	iqueue_enqueue(timer->slot, &timer->link);
+	wheel->nonEmpty[level] |= 1ull << index;
+}
+
+/*
+ * the next tick at which a slot is due, UINT64_MAX if
+ * there is none: the first slot after the current one,
+ * on the lowest level which has one, comes first
+ */
+static uint64_t next_tick(timer_wheel_t *wheel)
+{
+	uint64_t current = wheel->current;
+
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+		int shift = level * TIMER_WHEEL_SLOT_BITS;
+		uint64_t after = ~((2ull << digit(current, level)) - 1);
+		uint64_t bits = wheel->nonEmpty[level] & after;
+
+		if (!bits)
+			continue;
+		uint64_t high = current >> (shift + TIMER_WHEEL_SLOT_BITS)
+				<< (shift + TIMER_WHEEL_SLOT_BITS);
+		return high | (uint64_t)__builtin_ctzll(bits) << shift;
+	}
+	return UINT64_MAX;
+}
+
+/*
+ * process everything which is due up to @now, in ticks
+ */
+static void advance(timer_wheel_t *wheel, uint64_t now)
+{
+	uint64_t tick;
+
+	while ((tick = next_tick(wheel)) <= now) {
+		/* higher levels first, their timers may be due now too */
+		for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; --level) {
+			int index = digit(tick, level);
+			uint64_t below = (1ull << (level * TIMER_WHEEL_SLOT_BITS)) - 1;
+
+			if ((tick & below) || !(wheel->nonEmpty[level] & (1ull << index)))
+				continue;
+			iqueue_t *slot = &wheel->slots[level][index];
+			iqueue_link_t *link;
+			wheel->nonEmpty[level] &= ~(1ull << index);
+			while ((link = iqueue_dequeue(slot)) != NULL)
+				place_timer(wheel, iqueue_entry(link, wheel_timer_t, link), tick);
+		}
+
+		int index = digit(tick, 0);
+		iqueue_t *slot = &wheel->slots[0][index];
+		iqueue_link_t *link;
+		wheel->nonEmpty[0] &= ~(1ull << index);
+		while ((link = iqueue_dequeue(slot)) != NULL) {
+			wheel_timer_t *timer = iqueue_entry(link, wheel_timer_t, link);
+			timer->slot = &wheel->expired;
+			iqueue_enqueue(&wheel->expired, link);
+		}
+		wheel->current = tick;
+	}
+	/* nothing is due until after @now, so no timer is skipped */
+	if (now > wheel->current)
+		wheel->current = now;
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now)
+{
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+		for (int index = 0; index < TIMER_WHEEL_SLOTS; ++index)
+			iqueue_init(&wheel->slots[level][index]);
+		wheel->nonEmpty[level] = 0;
+	}
+	iqueue_init(&wheel->expired);
+	wheel->current = now >> TIMER_WHEEL_TICK_SHIFT;
+	wheel->count = 0;
+}
+
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t expires)
+{
+	/* rounded up, so that it never expires early */
+	timer->expires = (expires >> TIMER_WHEEL_TICK_SHIFT)
+			 + !!(expires & (TIMER_WHEEL_TICK_NS - 1));
+	if (timer->expires > MAX_TICK)
+		timer->expires = MAX_TICK;
+	if (timer->expires <= wheel->current)
+		timer->expires = wheel->current + 1;
+	place_timer(wheel, timer, wheel->current);
+	wheel->count++;
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer)
+{
+	if (!timer->slot)
+		return;
+	iqueue_remove(timer->slot, &timer->link);
+	if (timer->slot != &wheel->expired && !iqueue_length(timer->slot)) {
+		ptrdiff_t slot = timer->slot - &wheel->slots[0][0];
+		wheel->nonEmpty[slot / TIMER_WHEEL_SLOTS] &= ~(1ull << (slot % TIMER_WHEEL_SLOTS));
+	}
+	timer->slot = NULL;
+	wheel->count--;
+}
+
+wheel_timer_t *timer_wheel_expire(timer_wheel_t *wheel, uint64_t now)
+{
+	if (!iqueue_length(&wheel->expired))
+		advance(wheel, now >> TIMER_WHEEL_TICK_SHIFT);
+
+	iqueue_link_t *link = iqueue_dequeue(&wheel->expired);
+	if (!link)
+		return NULL;
+	wheel_timer_t *timer = iqueue_entry(link, wheel_timer_t, link);
+	timer->slot = NULL;
+	wheel->count--;
+	return timer;
+}
+
+uint64_t timer_wheel_next(timer_wheel_t *wheel)
+{
+	if (iqueue_length(&wheel->expired))
+		return 0;
+	uint64_t tick = next_tick(wheel);
+	return tick == UINT64_MAX ? UINT64_MAX : tick << TIMER_WHEEL_TICK_SHIFT;
+}
@@ -0,0 +1,131 @@
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iqueue.h"
+
+/*
+ * timer_wheel_t - Intrusive hierarchical timer wheel type
+ *
+ * A timer wheel keeps timers sorted into slots by expiration time, and the
+ * items embed their timer (wheel_timer_t), so no operation ever allocates
+ * memory. Times are in nanoseconds on any clock, rounded up to a tick of
+ * TIMER_WHEEL_TICK_NS: a timer never expires early, and up to a tick late.
+ *
+ * Each level has TIMER_WHEEL_SLOTS slots, each one covering as many ticks as a
+ * whole turn of the level below. A timer goes to the lowest level on which it
+ * falls in the current turn, and moves down a level once its slot is reached,
+ * until it expires from the first level. Adding and cancelling a timer are
+ * O(1), whatever the number of pending timers, and finding the next expiration
+ * costs one bit scan per level.
+ */
+#define TIMER_WHEEL_TICK_SHIFT 16
+#define TIMER_WHEEL_TICK_NS (1ull << TIMER_WHEEL_TICK_SHIFT)
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+/* Enough levels for any 64-bit time */
+#define TIMER_WHEEL_LEVELS \
+	((64 - TIMER_WHEEL_TICK_SHIFT + TIMER_WHEEL_SLOT_BITS - 1) / TIMER_WHEEL_SLOT_BITS)
+
+typedef struct wheel_timer {
+	iqueue_link_t link;
+	uint64_t expires; /* in ticks */
+	iqueue_t *slot; /* the queue it is in, NULL if not pending */
+} wheel_timer_t;
+
+typedef struct timer_wheel {
+	iqueue_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	uint64_t nonEmpty[TIMER_WHEEL_LEVELS]; /* bit i set if slot i has timers */
+	uint64_t current; /* last tick processed */
+	iqueue_t expired; /* expired, not returned yet */
+	int count;
+} timer_wheel_t;
+
+/*
+ * timer_wheel_entry - Get the item embedding a timer
+ * @timer: Address of the timer
+ * @type: Type of the item
+ * @member: Name of the timer member in @type
+ */
+#define timer_wheel_entry(timer, type, member) \
+	((type *)((char *)(timer) - offsetof(type, member)))
+
+/*
+ * timer_wheel_init - Initialize an empty wheel
+ * @wheel: Wheel to initialize
+ * @now: Current time
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now);
+
+/*
+ * timer_wheel_count - Number of pending timers of a wheel
+ * @wheel: Wheel to count the timers of
+ */
+static inline int timer_wheel_count(timer_wheel_t *wheel)
+{
+	return wheel->count;
+}
+
+/*
+ * timer_wheel_pending - Whether a timer is in a wheel
+ * @timer: Timer to check, which must have been added to a wheel or initialized
+ * by timer_wheel_timer_init()
+ */
+static inline bool timer_wheel_pending(wheel_timer_t *timer)
+{
+	return timer->slot != NULL;
+}
+
+/*
+ * timer_wheel_timer_init - Initialize a timer which is not pending
+ * @timer: Timer to initialize
+ */
+static inline void timer_wheel_timer_init(wheel_timer_t *timer)
+{
+	timer->slot = NULL;
+}
+
+/*
+ * timer_wheel_add - Add a timer
+ * @wheel: Wheel to add the timer to
+ * @timer: Timer to add, which must not be pending
+ * @expires: Time at which the timer expires
+ *
+ * A timer whose time has already come expires on the next call to
+ * timer_wheel_expire().
+ */
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t expires);
+
+/*
+ * timer_wheel_cancel - Remove a timer
+ * @wheel: Wheel the timer was added to
+ * @timer: Timer to remove, nothing happens if it is not pending
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+/*
+ * timer_wheel_expire - Remove an expired timer
+ * @wheel: Wheel to look into
+ * @now: Current time, which must never go backwards
+ *
+ * Return: A timer whose expiration time has come, which is no longer pending,
+ * NULL if there is none. Call it again until it returns NULL to get them all.
+ */
+wheel_timer_t *timer_wheel_expire(timer_wheel_t *wheel, uint64_t now);
+
+/*
+ * timer_wheel_next - Get the next time a timer may expire
+ * @wheel: Wheel to look into
+ *
+ * No timer expires before the returned time, though none may expire then
+ * either: a timer far away only moves closer then.
+ *
+ * Return: The next time timer_wheel_expire() needs to be called, UINT64_MAX if
+ * no timer is pending
+ */
+uint64_t timer_wheel_next(timer_wheel_t *wheel);
+
+#endif /* _TIMER_WHEEL_H */
@@ -1,16 +1,29 @@
+#define _GNU_SOURCE
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 #include <stdbool.h>
 #include <zconf.h>
 
 #include "context.h"
+#include "iqueue.h"
 #include "preempt.h"
-#include "queue.h"
+#include "rbtree.h"
+#include "scheduler.h"
+#include "slab.h"
+#include "timer_wheel.h"
 #include "uthread.h"
 
 /*
@@ -18,26 +31,749 @@
  * we need to know about a thread
  */
 typedef struct uthread_control_block{
+    iqueue_link_t link; //in one of the scheduler's queues
     uthread_t TID;
-    uthread_ctx_t *ctx; //include stack, sigmask, uc_mcontext
+    int prio; //priority level, higher runs first
+    int sliceLeft; //ticks left in the time slice
+    bool isReady; //in a run queue
+    struct run_queue *runQueue; //the one it is in, if ready
+    rbtree_node_t fairNode; //in the run queue, fair policy
+    uint64_t vruntime; //weighted run time, fair policy
+    uint64_t runStart; //when vruntime was last updated
+    unsigned int weight;
+    uthread_ctx_t ctx; //saved registers, see context.h
+    void *stack; //stack segment, NULL for main and until it first runs
+    size_t stackSize;
+    bool isFresh; //never ran: no stack nor context yet
+    uthread_func_t func; //what it runs, until it first runs
+    void *arg;
+    bool sharedStack; //runs on the shared stack
+    void *savedStack; //shared stack slice, while switched out
+    size_t savedSize;
+    size_t savedCapacity;
     int retval;
+    bool isFinished; //zombie, waiting to be joined
     bool isJoined; //indicate whether it is joined by other thread
+    bool isDetached; //freed as soon as it finishes, never joined
     uthread_t waitingThreadTID;
-}TCB;
+    wheel_timer_t timer; //sleeping, or waiting with a timeout
+    iqueue_t *waitQueue; //the queue it waits in with a timeout
+    bool timedOut; //its timer ended the wait
+} __attribute__((aligned(CACHE_LINE_SIZE))) TCB;
+
+/*
+ * With the FIFO policy, ready threads wait in one FIFO
+ * queue per priority level. Bit i of nonEmpty is set
+ * while level i has ready threads, so the highest ready
+ * level is found with a single bit scan.
+ *
+ * With the fair policy, ready threads are sorted by
+ * virtual runtime in fairTree. minVruntime only moves
+ * forward, and threads joining the run queue start no
+ * lower, so that they cannot monopolize the CPU to
+ * catch up with threads which kept running.
+ */
+struct run_queue {
+    iqueue_t levels[UTHREAD_PRIO_LEVELS_MAX];
+    uint64_t nonEmpty;
+    rbtree_t fairTree;
+    uint64_t minVruntime;
+};
+
+/*
+ * Scheduling policy, number of priority levels, time
+ * slice of each level in ticks, and number of workers to
+ * start, 0 for one per online CPU. A slice of 0 means the
+ * default of one tick.
+ */
+struct sched_config {
+    uthread_sched_policy_t policy;
+    int prioLevels;
+    int workers;
+    unsigned int prioSlice[UTHREAD_PRIO_LEVELS_MAX];
+};
+
+/*
+ * Settings for the scheduler the calling kernel thread
+ * will initialize, the scheduler then has its own copy
+ */
+static __thread struct sched_config schedConfig = {
+    UTHREAD_SCHED_FIFO, UTHREAD_PRIO_LEVELS_DEFAULT, 1
+};
+
+/*
+ * With the fair policy, a thread which wakes up only
+ * preempts the running thread if it is behind by more
+ * than this, in nanoseconds of virtual runtime
+ */
+#define FAIR_WAKEUP_GRANULARITY 1000000
+
+/*
+ * A worker is a kernel thread running threads, out of a
+ * run queue of its own. Its idle thread runs when it has
+ * nothing else to run: it steals ready threads from the
+ * other workers, or sleeps if there are none. The first
+ * worker is the kernel thread which initialized the
+ * library, and its idle thread runs on a stack of its
+ * own. The other workers are pthreads started by the
+ * library, and their idle thread is the pthread itself.
+ */
+struct worker {
+    struct run_queue runQueue;
+    TCB *runningThread;
+    TCB idleThread;
+    TCB *deadThread; //detached and finished, freed once switched away from
+    struct scheduler *sched; //the one it belongs to
+    pthread_t pthread;
+    int index;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/*
+ * The worker of the calling kernel thread, see this_worker()
+ */
+static __thread struct worker *thisWorker;
+
+/*
+ * the worker running the calling thread
+ * a thread may move to another worker each time it
+ * switches out, so the result must not be kept across
+ * a switch, and the compiler must not be allowed to
+ * reuse it either: the asm makes this function impure
+ */
+static __attribute__((noinline)) struct worker *this_worker(void)
+{
+    __asm__ volatile("" ::: "memory");
+    return thisWorker;
+}
+
+/*
+ * A TID is made of a slot index in the TID table (low
+ * bits) and of the generation of that slot (high bits).
+ * The generation of a slot is bumped every time the slot
+ * is released, so a stale TID never matches the thread
+ * which reuses its slot. Generation bits stop one bit
+ * short of 32, so a TID always fits in a positive int.
+ */
+#define TID_SLOT_BITS 20
+#define TID_GENERATION_BITS 11
+#define TID_SLOT_MASK ((1u << TID_SLOT_BITS) - 1)
+#define TID_GENERATION_MASK ((1u << TID_GENERATION_BITS) - 1)
+#define TID_MAX_SLOTS (1u << TID_SLOT_BITS)
+
+struct tid_slot {
+    TCB *thread; //NULL if the slot is free
+    uint32_t generation;
+    uint32_t nextFree;
+};
+
+/*
+ * Slots [0, used) have been handed out at least once.
+ * Released slots are chained from freeHead, stored as
+ * index + 1 so that 0 means the list is empty. Slot 0
+ * always belongs to main.
+ */
+struct tid_table {
+    struct tid_slot *slots;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t freeHead;
+};
+
+
+/* Size of the stack shared by the threads created with a shared stack */
+#define UTHREAD_SHARED_STACK_SIZE (8 << 20)
+
+/*
+ * Threads created with the shared stack attribute all run on the same stack.
+ * @owner is the thread whose frames currently live on it. Switching to a
+ * shared-stack thread which is not the owner goes through @switcherCtx: this
+ * helper context runs on its own small stack, so it can copy the owner's
+ * frames out and the next thread's frames in without stepping on itself.
+ */
+struct shared_stack {
+    void *stack;
+    size_t stackSize;
+    TCB *owner;
+    TCB *next;
+    uthread_ctx_t switcherCtx;
+    void *switcherStack;
+    size_t switcherStackSize;
+};
+
+
+/*
+ * Threads get their TCB from tcbSlab, except main, whose
+ * TCB is part of the scheduler. A thread with its own
+ * stack only gets it from the stack pool when it first
+ * runs, with its context, so threads which were created
+ * but did not run yet only cost their TCB. Contexts are
+ * all built from ctxTemplate, captured once. Freed stacks
+ * go back to the free list of their size class in the
+ * pool.
+ */
+
+/*
+ * Threads blocked on a file descriptor wait in the entry
+ * of that descriptor, readers and writers apart. seq[dir]
+ * counts the readiness events received for a direction,
+ * so that a thread can tell whether one came in between
+ * its failed attempt and the moment it parks: epoll only
+ * reports edges, and would not report it again.
+ */
+enum { IO_READ, IO_WRITE };
+
+struct io_wait {
+    iqueue_t waiters[2];
+    uint32_t seq[2];
+};
+
+/*
+ * The descriptors threads wait for are all registered in
+ * the epoll instance epollFd. A worker blocked in
+ * epoll_wait() is woken up through wakeFd when a thread
+ * becomes ready somewhere else.
+ */
+struct io_poller {
+    bool started; //epollFd and wakeFd exist
+    int epollFd;
+    int wakeFd;
+    struct io_wait **fds; //indexed by descriptor
+    int numFds;
+    int numWaiters;
+    bool polling; //a worker is blocked in epoll_wait()
+    bool kicked; //and wakeFd was written to
+    uint64_t deadline; //when it wakes up at the latest
+};
 
 /*
  * scheduler is used to coordinate the behaviors
  * of different threads
+ * Each kernel thread initializing the library gets a
+ * scheduler of its own, shared with nobody but the
+ * workers it starts. With several workers, everything
+ * here and in the workers is protected by lock, which
+ * preempt_disable() takes.
+ *
+ * A single lock is on purpose: switching threads touches
+ * several of these structures at once, e.g. exiting wakes
+ * the joiner up on another worker's run queue, and so do
+ * the synchronization objects built on sched_block(). The
+ * lock is only held to schedule, never while a thread
+ * runs, so workers scale with the work done between two
+ * scheduling operations, and contend when threads do
+ * little else than yield, block and wake each other.
  */
 typedef struct scheduler{
-    queue_t readyThreads;
-    TCB *runningThread;
-    queue_t waitingThreads;
-    queue_t finishedThreads;
-    uthread_t NEXT_TID;
+    struct worker *workers;
+    int numWorkers;
+    int numIdle; //workers sleeping on idleCond
+    bool stopping; //the workers return to their idle threads and exit
+    pthread_mutex_t lock;
+    pthread_cond_t idleCond;
+    iqueue_t waitingThreads;
+    iqueue_t finishedThreads;
+    struct sched_config config;
+    struct tid_table tidTable;
+    struct shared_stack sharedStack;
+    slab_t tcbSlab;
+    uthread_ctx_t ctxTemplate; //see uthread_ctx_template()
+    bool hasCtxTemplate;
+    TCB mainTCB;
+    struct io_poller io;
+    timer_wheel_t timers; //of sleeping threads, on CLOCK_MONOTONIC
+    unsigned int preemptHz; //preemption settings of the workers
+    uthread_preempt_clock_t preemptClock;
 }scheduler;
 
-scheduler threadScheduler = {NULL, NULL, NULL, NULL, 1};
+/*
+ * The scheduler of the calling kernel thread, NULL until
+ * the library is initialized on it. All the workers of a
+ * scheduler point to it, so unlike thisWorker, its value
+ * does not change when a thread moves to another worker.
+ */
+static __thread scheduler *threadScheduler;
+
+static uthread_t make_tid(uint32_t slot, uint32_t generation)
+{
+    return (generation << TID_SLOT_BITS) | slot;
+}
+
+/*
+ * find the thread of TID @tid in O(1)
+ * Return value:
+ * the thread, or NULL if there is no such thread
+ */
+static TCB *tid_lookup(uthread_t tid)
+{
+    uint32_t slot = tid & TID_SLOT_MASK;
+
+    if(slot >= threadScheduler->tidTable.used)
+        return NULL;
+    if(threadScheduler->tidTable.slots[slot].generation != tid >> TID_SLOT_BITS)
+        return NULL;
+    return threadScheduler->tidTable.slots[slot].thread;
+}
+
+/*
+ * give @thread a slot in the TID table and set its TID
+ * recently released slots are reused first
+ * must be called with preemption disabled
+ * Return value:
+ * -1 if the table is full or cannot grow, 0 if success
+ */
+static int tid_alloc(TCB *thread)
+{
+    uint32_t slot;
+
+    if(threadScheduler->tidTable.freeHead){
+        slot = threadScheduler->tidTable.freeHead - 1;
+        threadScheduler->tidTable.freeHead = threadScheduler->tidTable.slots[slot].nextFree;
+    }else{
+        if(threadScheduler->tidTable.used == TID_MAX_SLOTS)
+            return -1;
+        if(threadScheduler->tidTable.used == threadScheduler->tidTable.capacity){
+            uint32_t capacity = threadScheduler->tidTable.capacity ? 2 * threadScheduler->tidTable.capacity : 64;
+            struct tid_slot *slots = realloc(threadScheduler->tidTable.slots, capacity * sizeof(struct tid_slot));
+            if(!slots)
+                return -1;
+            threadScheduler->tidTable.slots = slots;
+            threadScheduler->tidTable.capacity = capacity;
+        }
+        slot = threadScheduler->tidTable.used++;
+        threadScheduler->tidTable.slots[slot].generation = 0;
+    }
+    threadScheduler->tidTable.slots[slot].thread = thread;
+    thread->TID = make_tid(slot, threadScheduler->tidTable.slots[slot].generation);
+    return 0;
+}
+
+/*
+ * release the slot of thread @tid
+ * must be called with preemption disabled
+ */
+static void tid_free(uthread_t tid)
+{
+    uint32_t slot = tid & TID_SLOT_MASK;
+
+    threadScheduler->tidTable.slots[slot].thread = NULL;
+    threadScheduler->tidTable.slots[slot].generation = (threadScheduler->tidTable.slots[slot].generation + 1) & TID_GENERATION_MASK;
+    threadScheduler->tidTable.slots[slot].nextFree = threadScheduler->tidTable.freeHead;
+    threadScheduler->tidTable.freeHead = slot + 1;
+}
+
+/*
+ * the scheduler's queues link threads through
+ * TCB->link, so moving a thread around never
+ * allocates memory
+ */
+static void enqueue_thread(iqueue_t *queue, TCB *thread)
+{
+    iqueue_enqueue(queue, &thread->link);
+}
+
+static TCB *dequeue_thread(iqueue_t *queue)
+{
+    iqueue_link_t *link = iqueue_dequeue(queue);
+    return link ? iqueue_entry(link, TCB, link) : NULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * charge @thread, which is running, for the time since
+ * its last update, scaled down by its weight
+ * the run time of a thread is the time during which it
+ * is the running thread, even if blocked in a syscall
+ */
+static void account_thread(TCB *thread, uint64_t now)
+{
+    thread->vruntime += (now - thread->runStart) * UTHREAD_WEIGHT_DEFAULT / thread->weight;
+    thread->runStart = now;
+}
+
+static bool vruntime_less(const rbtree_node_t *a, const rbtree_node_t *b)
+{
+    return rbtree_entry(a, TCB, fairNode)->vruntime < rbtree_entry(b, TCB, fairNode)->vruntime;
+}
+
+/*
+ * the run queues only hold ready threads
+ * all these must be called with preemption disabled
+ */
+static void make_ready(struct run_queue *runQueue, TCB *thread)
+{
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR){
+        rbtree_insert(&runQueue->fairTree, &thread->fairNode, vruntime_less);
+    }else{
+        enqueue_thread(&runQueue->levels[thread->prio], thread);
+        runQueue->nonEmpty |= 1ull << thread->prio;
+    }
+    thread->isReady = true;
+    thread->runQueue = runQueue;
+}
+
+static void remove_ready(TCB *thread)
+{
+    struct run_queue *runQueue = thread->runQueue;
+
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR){
+        rbtree_remove(&runQueue->fairTree, &thread->fairNode);
+    }else{
+        iqueue_t *level = &runQueue->levels[thread->prio];
+        iqueue_remove(level, &thread->link);
+        if(!iqueue_length(level))
+            runQueue->nonEmpty &= ~(1ull << thread->prio);
+    }
+    thread->isReady = false;
+}
+
+/*
+ * Return value:
+ * the highest priority of the ready threads,
+ * -1 if there is no ready thread
+ */
+static int highest_ready(struct run_queue *runQueue)
+{
+    uint64_t nonEmpty = runQueue->nonEmpty;
+    return nonEmpty ? 63 - __builtin_clzll(nonEmpty) : -1;
+}
+
+/*
+ * dequeue the oldest of the most urgent ready threads,
+ * or the one with the least virtual runtime
+ */
+static TCB *pick_next_thread(struct run_queue *runQueue)
+{
+    TCB *thread;
+
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR){
+        rbtree_node_t *first = rbtree_first(&runQueue->fairTree);
+        if(!first)
+            return NULL;
+        thread = rbtree_entry(first, TCB, fairNode);
+        if(thread->vruntime > runQueue->minVruntime)
+            runQueue->minVruntime = thread->vruntime;
+    }else{
+        int prio = highest_ready(runQueue);
+        if(prio < 0)
+            return NULL;
+        thread = iqueue_entry(iqueue_peek(&runQueue->levels[prio]), TCB, link);
+    }
+    remove_ready(thread);
+    return thread;
+}
+
+/*
+ * whether the ready threads of @runQueue should share
+ * the CPU with @running
+ */
+static bool has_competition(struct run_queue *runQueue, TCB *running)
+{
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR)
+        return rbtree_count(&runQueue->fairTree) > 0;
+    return highest_ready(runQueue) >= running->prio;
+}
+
+/*
+ * whether ready @thread should take the CPU from @running
+ * right away
+ */
+static bool should_preempt(TCB *thread, TCB *running)
+{
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR){
+        account_thread(running, now_ns());
+        return thread->vruntime + FAIR_WAKEUP_GRANULARITY < running->vruntime;
+    }
+    return thread->prio > running->prio;
+}
+
+static int slice_ticks(int prio)
+{
+    unsigned int ticks = threadScheduler->config.prioSlice[prio];
+    return ticks ? ticks : 1;
+}
+
+/*
+ * the run queue a thread which becomes ready goes to: the
+ * one of our worker, except for main, which always runs
+ * on the first worker, the kernel thread it started on,
+ * since it could not return from its callers elsewhere
+ */
+static struct run_queue *ready_queue(TCB *thread)
+{
+    if(thread == &threadScheduler->mainTCB)
+        return &threadScheduler->workers[0].runQueue;
+    return &this_worker()->runQueue;
+}
+
+/*
+ * wake up the worker blocked in epoll_wait(), if any
+ * must be called with preemption disabled
+ */
+static void io_kick(void)
+{
+    struct io_poller *io = &threadScheduler->io;
+
+    if(io->polling && !io->kicked){
+        uint64_t one = 1;
+        io->kicked = true;
+        if(write(io->wakeFd, &one, sizeof(one)) < 0)
+            perror("write");
+    }
+}
+
+/*
+ * queue @thread, which was created or blocked, and let
+ * the other workers know
+ */
+static void ready_thread(TCB *thread)
+{
+    struct run_queue *runQueue = ready_queue(thread);
+
+    //no credit for the time spent blocked
+    if(thread->vruntime < runQueue->minVruntime)
+        thread->vruntime = runQueue->minVruntime;
+    make_ready(runQueue, thread);
+    //idle workers can steal it, only the first one can run main
+    bool pinned = runQueue != &this_worker()->runQueue;
+    if(threadScheduler->numIdle && pinned)
+        pthread_cond_broadcast(&threadScheduler->idleCond);
+    else if(threadScheduler->numIdle)
+        pthread_cond_signal(&threadScheduler->idleCond);
+    //the first worker may be the one waiting for I/O
+    if(pinned || !threadScheduler->numIdle)
+        io_kick();
+}
+
+/*
+ * make @thread ready after it was created or blocked
+ * ticking is needed if it competes with the running
+ * thread, and if it is more urgent it should run now
+ */
+static void wake_thread(TCB *thread)
+{
+    //the thread is queued on our worker
+    struct worker *worker = this_worker();
+    TCB *running = worker->runningThread;
+
+    ready_thread(thread);
+    if(has_competition(&worker->runQueue, running))
+        preempt_arm();
+    if(should_preempt(thread, running))
+        preempt_resched();
+}
+
+/* Number of events handled per epoll_wait() */
+#define IO_EVENTS 64
+
+/*
+ * create the epoll instance the first time a thread
+ * waits for I/O
+ * must be called with preemption disabled
+ * Return value:
+ * -1 if failure, 0 if success
+ */
+static int io_start(void)
+{
+    struct io_poller *io = &threadScheduler->io;
+
+    if(io->started)
+        return 0;
+    io->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(io->epollFd < 0)
+        return -1;
+    io->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = io->wakeFd};
+    if(io->wakeFd < 0 || epoll_ctl(io->epollFd, EPOLL_CTL_ADD, io->wakeFd, &event) < 0){
+        if(io->wakeFd >= 0)
+            close(io->wakeFd);
+        close(io->epollFd);
+        return -1;
+    }
+    io->started = true;
+    return 0;
+}
+
+/*
+ * find the wait entry of @fd, creating it if needed
+ * must be called with preemption disabled
+ * Return value:
+ * the entry, or NULL if it cannot be allocated
+ */
+static struct io_wait *io_entry(int fd)
+{
+    struct io_poller *io = &threadScheduler->io;
+
+    if(fd >= io->numFds){
+        int numFds = io->numFds ? io->numFds : 64;
+        while(numFds <= fd)
+            numFds *= 2;
+        struct io_wait **fds = realloc(io->fds, numFds * sizeof(struct io_wait*));
+        if(!fds)
+            return NULL;
+        memset(fds + io->numFds, 0, (numFds - io->numFds) * sizeof(struct io_wait*));
+        io->fds = fds;
+        io->numFds = numFds;
+    }
+
+    //entries are kept for the next user of the descriptor
+    struct io_wait *wait = io->fds[fd];
+    if(!wait){
+        wait = calloc(1, sizeof(struct io_wait));
+        if(!wait)
+            return NULL;
+        iqueue_init(&wait->waiters[IO_READ]);
+        iqueue_init(&wait->waiters[IO_WRITE]);
+        io->fds[fd] = wait;
+    }
+    return wait;
+}
+
+/*
+ * wait for events until @deadline (UINT64_MAX for no
+ * limit), to the nanosecond if the kernel can
+ * Return value:
+ * as for epoll_wait()
+ */
+static int io_wait_events(struct epoll_event *events, uint64_t deadline)
+{
+    int epollFd = threadScheduler->io.epollFd;
+
+    if(deadline == UINT64_MAX)
+        return epoll_wait(epollFd, events, IO_EVENTS, -1);
+    uint64_t now = now_ns();
+    uint64_t delay = deadline > now ? deadline - now : 0;
+    struct timespec timeout = {delay / 1000000000, delay % 1000000000};
+    int numEvents = epoll_pwait2(epollFd, events, IO_EVENTS, &timeout, NULL);
+    if(numEvents < 0 && errno == ENOSYS)
+        numEvents = epoll_wait(epollFd, events, IO_EVENTS, (delay + 999999) / 1000000);
+    return numEvents;
+}
+
+/*
+ * make the threads waiting for the descriptors which are
+ * ready ready again, if @wait is set waiting for one
+ * until the next timer if there is none
+ * a worker which blocks has nothing else to run: unlike
+ * a running thread, it does not need to be preempted by
+ * the threads it wakes up
+ * must be called with preemption disabled
+ */
+static void io_poll(bool wait)
+{
+    struct io_poller *io = &threadScheduler->io;
+    struct epoll_event events[IO_EVENTS];
+    int numEvents;
+
+    if(!io->numWaiters && !(wait && timer_wheel_count(&threadScheduler->timers)))
+        return;
+    if(wait){
+        //let the other workers run while we wait
+        io->deadline = timer_wheel_next(&threadScheduler->timers);
+        io->polling = true;
+        if(threadScheduler->numWorkers > 1)
+            pthread_mutex_unlock(&threadScheduler->lock);
+        numEvents = io_wait_events(events, io->deadline);
+        if(threadScheduler->numWorkers > 1)
+            pthread_mutex_lock(&threadScheduler->lock);
+        io->polling = false;
+        io->kicked = false;
+    }else{
+        numEvents = epoll_wait(io->epollFd, events, IO_EVENTS, 0);
+    }
+
+    for (int i = 0; i < numEvents; ++i) {
+        int fd = events[i].data.fd;
+        if(fd == io->wakeFd){
+            uint64_t count;
+            if(read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                perror("read");
+            continue;
+        }
+
+        //errors and hang ups are for both directions
+        struct io_wait *entry = io->fds[fd];
+        uint32_t ready[2] = {
+            EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR,
+            EPOLLOUT | EPOLLHUP | EPOLLERR,
+        };
+        for (int dir = IO_READ; dir <= IO_WRITE; ++dir) {
+            if(!(events[i].events & ready[dir]))
+                continue;
+            entry->seq[dir]++;
+            TCB *thread;
+            while((thread = dequeue_thread(&entry->waiters[dir])) != NULL){
+                io->numWaiters--;
+                if(wait)
+                    ready_thread(thread);
+                else
+                    wake_thread(thread);
+            }
+        }
+    }
+}
+
+/*
+ * make the threads whose timer expired ready again, a
+ * thread waiting with a timeout leaving its wait queue
+ * @wait is set when the running thread blocks, as for
+ * io_poll()
+ * must be called with preemption disabled
+ */
+static void run_timers(bool wait)
+{
+    timer_wheel_t *timers = &threadScheduler->timers;
+    wheel_timer_t *timer;
+
+    if(!timer_wheel_count(timers))
+        return;
+    uint64_t now = now_ns();
+    while((timer = timer_wheel_expire(timers, now)) != NULL){
+        TCB *thread = timer_wheel_entry(timer, TCB, timer);
+        if(thread->waitQueue){
+            iqueue_remove(thread->waitQueue, &thread->link);
+            thread->waitQueue = NULL;
+            thread->timedOut = true;
+        }
+        if(wait)
+            ready_thread(thread);
+        else
+            wake_thread(thread);
+    }
+}
+
+/*
+ * set the timer of @thread, which is about to block in
+ * @waitQueue (NULL if it just sleeps), to @deadline
+ * must be called with preemption disabled
+ * Return value:
+ * -1 if failure, 0 if success
+ */
+static int arm_timer(TCB *thread, uint64_t deadline, iqueue_t *waitQueue)
+{
+    struct io_poller *io = &threadScheduler->io;
+
+    //idle workers sleep in epoll_wait() until the next timer
+    if(io_start())
+        return -1;
+    thread->waitQueue = waitQueue;
+    thread->timedOut = false;
+    timer_wheel_add(&threadScheduler->timers, &thread->timer, deadline);
+    //the polling worker may sleep for too long, or an idle
+    //worker needs to start polling
+    if(io->polling && deadline < io->deadline)
+        io_kick();
+    else if(!io->polling && threadScheduler->numIdle)
+        pthread_cond_signal(&threadScheduler->idleCond);
+    //a thread running alone needs ticks to fire it
+    preempt_arm();
+    return 0;
+}
 
 /*
  * we need to add main thread to threadScheduler
@@ -53,124 +789,851 @@ scheduler threadScheduler = {NULL, NULL, NULL, NULL, 1};
  * that's the reason why professor don't initialize
  * ctx[0])
  */
-int add_main_thread_to_scheduler()
+int add_main_thread_to_scheduler()
+{
+    iqueue_init(&threadScheduler->finishedThreads);
+    iqueue_init(&threadScheduler->waitingThreads);
+    threadScheduler->tcbSlab = slab_create(sizeof(TCB));
+    if(!threadScheduler->tcbSlab)
+        return -1;
+
+    TCB *mainThread = &threadScheduler->mainTCB;
+    //main always gets slot 0, hence TID 0
+    if(tid_alloc(mainThread))
+        return -1;
+    mainThread->prio = threadScheduler->config.prioLevels / 2;
+    mainThread->sliceLeft = slice_ticks(mainThread->prio);
+    mainThread->isReady = false;
+    mainThread->vruntime = 0;
+    mainThread->runStart = now_ns();
+    mainThread->weight = UTHREAD_WEIGHT_DEFAULT;
+    mainThread->retval = -1;
+    mainThread->isFinished = false;
+    mainThread->isJoined = false; //it should be always false, main will not be joined by other
+    mainThread->waitingThreadTID = 0;
+    timer_wheel_timer_init(&mainThread->timer);
+    mainThread->waitQueue = NULL;
+    mainThread->timedOut = false;
+    mainThread->stack = NULL; //main runs on the process stack
+    mainThread->stackSize = 0;
+    mainThread->sharedStack = false;
+    mainThread->savedStack = NULL;
+    mainThread->savedSize = 0;
+    mainThread->savedCapacity = 0;
+    threadScheduler->workers[0].runningThread = mainThread;
+    return 0;
+}
+
+/*
+ * steal a ready thread for @thief from the first other
+ * worker which has some
+ * must be called with preemption disabled
+ */
+static TCB *steal_thread(struct worker *thief)
+{
+    TCB *mainThread = &threadScheduler->mainTCB;
+
+    for (int i = 1; i < threadScheduler->numWorkers; ++i) {
+        struct worker *victim = &threadScheduler->workers[(thief->index + i) % threadScheduler->numWorkers];
+        struct run_queue *runQueue = &victim->runQueue;
+        //main stays on its kernel thread, see ready_queue()
+        bool skipMain = mainThread->isReady && mainThread->runQueue == runQueue;
+        if(skipMain)
+            remove_ready(mainThread);
+        TCB *thread = pick_next_thread(runQueue);
+        if(skipMain)
+            make_ready(runQueue, mainThread);
+        if(thread)
+            return thread;
+    }
+    return NULL;
+}
+
+static void dispatch_thread(TCB *prev, TCB *next);
+static TCB *next_thread(struct worker *worker);
+static int start_thread(TCB *thread);
+static void abort_thread(TCB *thread);
+static void reap_dead_thread(struct worker *worker);
+
+/*
+ * body of the idle thread of @arg, a worker
+ * it is entered with preemption disabled, and never
+ * returns: it runs the threads of its worker, or
+ * stolen ones, and sleeps when there are none, until
+ * the scheduler stops
+ */
+static void worker_loop(void *arg)
+{
+    //the idle thread never moves to another worker
+    struct worker *worker = arg;
+
+    while(!threadScheduler->stopping){
+        run_timers(true);
+        TCB *next = pick_next_thread(&worker->runQueue);
+        if(!next)
+            next = steal_thread(worker);
+        if(next){
+            dispatch_thread(&worker->idleThread, next);
+            continue;
+        }
+        //one idle worker waits for I/O and timers, the others sleep
+        if((threadScheduler->io.numWaiters || timer_wheel_count(&threadScheduler->timers))
+        && !threadScheduler->io.polling){
+            io_poll(true);
+            continue;
+        }
+        threadScheduler->numIdle++;
+        pthread_cond_wait(&threadScheduler->idleCond, &threadScheduler->lock);
+        threadScheduler->numIdle--;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *worker = arg;
+    scheduler *sched = worker->sched;
+    sigset_t tick;
+
+    //ticks were blocked until we know who we are, and the
+    //idle thread must never take them
+    threadScheduler = sched;
+    thisWorker = worker;
+    worker->runningThread = &worker->idleThread;
+    preempt_share(&sched->lock);
+    preempt_start();
+    uthread_preempt_config(sched->preemptHz, sched->preemptClock);
+    preempt_disable();
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGVTALRM);
+    pthread_sigmask(SIG_UNBLOCK, &tick, NULL);
+
+    worker_loop(worker);
+
+    //the scheduler is going away, along with our timer
+    pthread_sigmask(SIG_BLOCK, &tick, NULL);
+    preempt_forget();
+    preempt_enable();
+    preempt_stop();
+    //the stacks freed here went to our own pool
+    uthread_stack_pool_config(0, 0);
+    return NULL;
+}
+
+/*
+ * make the workers share the scheduler, give the first
+ * worker an idle thread, and start the other workers
+ * Return value:
+ * -1 if failure, 0 if success
+ */
+static int start_workers(void)
+{
+    struct worker *first = &threadScheduler->workers[0];
+    size_t stackSize = UTHREAD_STACK_SIZE;
+    sigset_t tick, oldMask;
+
+    if(pthread_mutex_init(&threadScheduler->lock, NULL)
+    || pthread_cond_init(&threadScheduler->idleCond, NULL))
+        return -1;
+    preempt_share(&threadScheduler->lock);
+
+    void *stack = uthread_ctx_alloc_stack(&stackSize);
+    if(!stack || uthread_ctx_init_plain(&first->idleThread.ctx, stack, stackSize,
+                                        worker_loop, first))
+        return -1;
+    first->idleThread.stack = stack;
+    first->idleThread.stackSize = stackSize;
+
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGVTALRM);
+    pthread_sigmask(SIG_BLOCK, &tick, &oldMask);
+    //the workers tick like us
+    preempt_get_config(&threadScheduler->preemptHz, &threadScheduler->preemptClock);
+    for (int i = 1; i < threadScheduler->numWorkers; ++i) {
+        struct worker *worker = &threadScheduler->workers[i];
+        if(pthread_create(&worker->pthread, NULL, worker_main, worker)){
+            pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+            return -1;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    return 0;
+}
+
+static pthread_key_t runtimeKey;
+static pthread_once_t runtimeKeyOnce = PTHREAD_ONCE_INIT;
+static void runtime_key_destructor(void *arg);
+
+static void create_runtime_key(void)
+{
+    pthread_key_create(&runtimeKey, runtime_key_destructor);
+}
+
+/*
+ * initialize the library on the calling kernel thread the
+ * first time it is needed there
+ * the kernel thread gets a scheduler of its own, and
+ * becomes its first worker
+ * Return value:
+ * -1 if failure, 0 if success
+ */
+static int init_runtime(void)
+{
+    if(threadScheduler)
+        return 0;
+
+    scheduler *sched;
+    if(posix_memalign((void**)&sched, CACHE_LINE_SIZE, sizeof(scheduler)))
+        return -1;
+    memset(sched, 0, sizeof(scheduler));
+    sched->config = schedConfig;
+
+    int numWorkers = sched->config.workers ? sched->config.workers : sysconf(_SC_NPROCESSORS_ONLN);
+    if(numWorkers < 1)
+        numWorkers = 1;
+    struct worker *workers;
+    if(posix_memalign((void**)&workers, CACHE_LINE_SIZE, numWorkers * sizeof(struct worker))){
+        free(sched);
+        return -1;
+    }
+    memset(workers, 0, numWorkers * sizeof(struct worker));
+    for (int i = 0; i < numWorkers; ++i) {
+        struct run_queue *runQueue = &workers[i].runQueue;
+        for (int j = 0; j < UTHREAD_PRIO_LEVELS_MAX; ++j)
+            iqueue_init(&runQueue->levels[j]);
+        rbtree_init(&runQueue->fairTree);
+        workers[i].index = i;
+        workers[i].sched = sched;
+        workers[i].idleThread.weight = UTHREAD_WEIGHT_DEFAULT;
+        workers[i].idleThread.runStart = now_ns();
+    }
+    sched->workers = workers;
+    sched->numWorkers = numWorkers;
+    timer_wheel_init(&sched->timers, now_ns());
+    threadScheduler = sched;
+    thisWorker = &workers[0];
+
+    if(add_main_thread_to_scheduler())
+        return -1;
+    //free it all when the kernel thread exits
+    pthread_once(&runtimeKeyOnce, create_runtime_key);
+    pthread_setspecific(runtimeKey, sched);
+    preempt_start();
+    if(numWorkers > 1 && start_workers()){
+        perror("start_workers");
+        return -1;
+    }
+    return 0;
+}
+
+int uthread_attr_init(uthread_attr_t *attr)
+{
+    if(!attr)
+        return -1;
+    attr->stacksize = UTHREAD_STACK_SIZE;
+    attr->sharedstack = 0;
+    attr->detached = 0;
+    return 0;
+}
+
+int uthread_attr_setstacksize(uthread_attr_t *attr, size_t stacksize)
+{
+    if(!attr || stacksize < UTHREAD_STACK_MIN)
+        return -1;
+    attr->stacksize = stacksize;
+    return 0;
+}
+
+int uthread_attr_setsharedstack(uthread_attr_t *attr, int sharedstack)
+{
+    if(!attr)
+        return -1;
+#ifndef UTHREAD_CTX_NATIVE
+    //the saved stack pointer is needed to know what to copy
+    if(sharedstack)
+        return -1;
+#endif
+    attr->sharedstack = sharedstack;
+    return 0;
+}
+
+int uthread_attr_setdetached(uthread_attr_t *attr, int detached)
+{
+    if(!attr)
+        return -1;
+    attr->detached = detached;
+    return 0;
+}
+
+int uthread_create(uthread_func_t func, void *arg)
+{
+    return uthread_create_attr(func, arg, NULL);
+}
+
+#ifdef UTHREAD_CTX_NATIVE
+/*
+ * copy the frames of @thread, from its saved stack
+ * pointer to the top of the shared stack, into a
+ * buffer of the same size
+ */
+static void save_shared_stack(TCB *thread)
+{
+    char *top = (char*)threadScheduler->sharedStack.stack + threadScheduler->sharedStack.stackSize;
+    char *sp = uthread_ctx_get_sp(&thread->ctx);
+    size_t size = top - sp;
+
+    //keep the buffer right-sized, but don't realloc for small changes
+    if(size > thread->savedCapacity || size < thread->savedCapacity / 2){
+        void *buffer = realloc(thread->savedStack, size);
+        if(!buffer){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        thread->savedStack = buffer;
+        thread->savedCapacity = size;
+    }
+    memcpy(thread->savedStack, sp, size);
+    thread->savedSize = size;
+}
+
+static void restore_shared_stack(TCB *thread)
+{
+    char *top = (char*)threadScheduler->sharedStack.stack + threadScheduler->sharedStack.stackSize;
+
+    memcpy(top - thread->savedSize, thread->savedStack, thread->savedSize);
+}
+
+/*
+ * body of the switcher context
+ * it is entered with preemption disabled, and
+ * never returns: each time it is switched to, it
+ * hands the shared stack over to threadScheduler->sharedStack.next
+ */
+static void shared_stack_switcher(void *arg)
+{
+    while(1){
+        TCB *next = threadScheduler->sharedStack.next;
+        if(threadScheduler->sharedStack.owner)
+            save_shared_stack(threadScheduler->sharedStack.owner);
+        restore_shared_stack(next);
+        threadScheduler->sharedStack.owner = next;
+        uthread_ctx_switch(&threadScheduler->sharedStack.switcherCtx, &next->ctx);
+    }
+}
+
+/*
+ * allocate the shared stack and the switcher context
+ * the first time a shared-stack thread is created
+ */
+static int init_shared_stack()
+{
+    if(threadScheduler->sharedStack.stack)
+        return 0;
+
+    threadScheduler->sharedStack.stackSize = UTHREAD_SHARED_STACK_SIZE;
+    threadScheduler->sharedStack.switcherStackSize = UTHREAD_STACK_MIN;
+    threadScheduler->sharedStack.stack = uthread_ctx_alloc_stack(&threadScheduler->sharedStack.stackSize);
+    threadScheduler->sharedStack.switcherStack = uthread_ctx_alloc_stack(&threadScheduler->sharedStack.switcherStackSize);
+    if(!threadScheduler->sharedStack.stack || !threadScheduler->sharedStack.switcherStack)
+        return -1;
+    return uthread_ctx_init_plain(&threadScheduler->sharedStack.switcherCtx,
+                                  threadScheduler->sharedStack.switcherStack,
+                                  threadScheduler->sharedStack.switcherStackSize,
+                                  shared_stack_switcher, NULL);
+}
+#else
+static int init_shared_stack()
+{
+    return -1;
+}
+#endif
+
+/*
+ * switch from @prev (the running thread) to @next
+ * must be called with preemption disabled
+ */
+static void switch_thread(TCB *prev, TCB *next)
+{
+#ifdef UTHREAD_CTX_NATIVE
+    //next's frames need to be copied back on the shared stack first
+    if(next->sharedStack && next != threadScheduler->sharedStack.owner){
+        threadScheduler->sharedStack.next = next;
+        uthread_ctx_switch(&prev->ctx, &threadScheduler->sharedStack.switcherCtx);
+        return;
+    }
+#endif
+    uthread_ctx_switch(&prev->ctx, &next->ctx);
+}
+
+/*
+ * make @next the running thread, with a fresh time
+ * slice, and switch to it from @prev
+ * must be called with preemption disabled
+ */
+static void dispatch_thread(TCB *prev, TCB *next)
+{
+    struct worker *worker = this_worker();
+
+    //nothing was allocated for it until now, and it
+    //finishes right away if that fails
+    while(next->isFresh && start_thread(next)){
+        abort_thread(next);
+        next = next_thread(worker);
+        //we were the only one left to run, possibly woken
+        //up by its end
+        if(next == prev)
+            return;
+    }
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR){
+        uint64_t now = now_ns();
+        account_thread(prev, now);
+        next->runStart = now;
+    }
+    worker->runningThread = next;
+    next->sliceLeft = slice_ticks(next->prio);
+    //others need ticks to get their turn
+    if(has_competition(&worker->runQueue, next))
+        preempt_arm();
+    //what was deferred until now was meant for @prev
+    preempt_forget();
+    switch_thread(prev, next);
+    //we may have left a dead thread behind, possibly on another worker
+    reap_dead_thread(this_worker());
+}
+
+/*
+ * the thread to switch to when the running thread of
+ * @worker blocks or exits
+ * must be called with preemption disabled
+ */
+static TCB *next_thread(struct worker *worker)
+{
+    //give the worker back, see stop_workers()
+    if(threadScheduler->stopping)
+        return &worker->idleThread;
+    run_timers(true);
+    TCB *next = pick_next_thread(&worker->runQueue);
+    //the idle thread looks for threads on other workers
+    if(!next && threadScheduler->numWorkers > 1)
+        return &worker->idleThread;
+    //nothing but I/O and timers can make a thread ready anymore
+    while(!next && (threadScheduler->io.numWaiters
+                    || timer_wheel_count(&threadScheduler->timers))){
+        io_poll(true);
+        run_timers(true);
+        next = pick_next_thread(&worker->runQueue);
+    }
+    return next;
+}
+
+/*
+ * allocate a TCB for a thread which will get a stack of
+ * @stackSize bytes when it first runs, or will run on the
+ * shared stack if @shared is set
+ * must be called with preemption disabled
+ */
+static TCB *alloc_thread(size_t stackSize, bool shared)
+{
+    if(shared && init_shared_stack())
+        return NULL;
+    //the template of the contexts, captured by the first creator
+    if(!threadScheduler->hasCtxTemplate){
+        if(uthread_ctx_template(&threadScheduler->ctxTemplate))
+            return NULL;
+        threadScheduler->hasCtxTemplate = true;
+    }
+    TCB *thread = slab_alloc(threadScheduler->tcbSlab);
+    if(!thread)
+        return NULL;
+
+    if(shared){
+        thread->stack = threadScheduler->sharedStack.stack;
+        thread->stackSize = threadScheduler->sharedStack.stackSize;
+    }else{
+        thread->stack = NULL;
+        thread->stackSize = stackSize;
+    }
+    thread->sharedStack = shared;
+    thread->isFresh = true;
+    return thread;
+}
+
+/*
+ * give @thread, which never ran, its stack and context
+ * must be called with preemption disabled
+ * Return value:
+ * -1 if its stack could not be allocated, 0 otherwise
+ */
+static int start_thread(TCB *thread)
+{
+    if(!thread->sharedStack){
+        thread->stack = uthread_ctx_alloc_stack(&thread->stackSize);
+        if(!thread->stack)
+            return -1;
+    }
+    uthread_ctx_init_from(&thread->ctx, &threadScheduler->ctxTemplate,
+                          thread->stack, thread->stackSize, thread->func, thread->arg);
+    thread->isFresh = false;
+    return 0;
+}
+
+/*
+ * free everything owned by @thread
+ * must be called with preemption disabled
+ */
+static void free_thread(TCB *thread)
+{
+    free(thread->savedStack);
+    if(thread == &threadScheduler->mainTCB)
+        return;
+    if(!thread->sharedStack && thread->stack)
+        uthread_ctx_destroy_stack(thread->stack, thread->stackSize);
+    slab_free(threadScheduler->tcbSlab, thread);
+}
+
+/*
+ * free the detached thread which last finished on
+ * @worker, now that nothing runs on its stack anymore
+ * must be called with preemption disabled
+ */
+static void reap_dead_thread(struct worker *worker)
+{
+    if(!worker->deadThread)
+        return;
+    free_thread(worker->deadThread);
+    worker->deadThread = NULL;
+}
+
+/*
+ * initialize the state of @thread, a new thread of
+ * @creator which will run @func(@arg)
+ * must be called with preemption disabled
+ */
+static void init_thread(TCB *thread, TCB *creator, uthread_func_t func, void *arg,
+                        bool detached)
+{
+    thread->func = func;
+    thread->arg = arg;
+    //a new thread starts with the priority of its creator
+    thread->prio = creator->prio;
+    thread->weight = creator->weight;
+    thread->vruntime = 0;
+    thread->isReady = false;
+    thread->retval = -1; //set minus 1 as its initial value
+    thread->isFinished = false;
+    thread->savedStack = NULL;
+    thread->savedSize = 0;
+    thread->savedCapacity = 0;
+    thread->isJoined = false;
+    thread->isDetached = detached;
+    thread->waitingThreadTID = 0;
+    timer_wheel_timer_init(&thread->timer);
+    thread->waitQueue = NULL;
+    thread->timedOut = false;
+}
+
+/*
+ *  if it is the first time we call
+ *  uthread_create in the main, we need to
+ *  register main as a thread in threadScheduler
+ */
+int uthread_create_attr(uthread_func_t func, void *arg,
+                        const uthread_attr_t *attr)
+{
+    size_t stackSize = attr ? attr->stacksize : UTHREAD_STACK_SIZE;
+    bool shared = attr ? attr->sharedstack : false;
+
+    //check if it is our first time to call uthread_create
+    if(init_runtime())
+        return -1;
+
+    //the shared stack can only be used by one worker
+    if(shared && threadScheduler->numWorkers > 1)
+        return -1;
+
+    //disable preempt when change threadScheduler
+    //the thread allocators are part of it
+    preempt_disable();
+    TCB *creator = this_worker()->runningThread;
+    //its stack is the one most likely to be reused right away
+    reap_dead_thread(this_worker());
+
+    TCB *newThread = alloc_thread(stackSize, shared);
+    if(!newThread){
+        preempt_enable();
+        perror("mmap");
+        return -1;
+    }
+    //check if we ran out of TIDs
+    if(tid_alloc(newThread)){
+        free_thread(newThread);
+        preempt_enable();
+        return -1;
+    }
+    init_thread(newThread, creator, func, arg, attr ? attr->detached : false);
+    uthread_t TID = newThread->TID;
+
+    wake_thread(newThread);
+
+    preempt_enable();
+
+    return TID;
+}
+
+int uthread_create_n(uthread_func_t func, void **args, int n, uthread_t *tids)
+{
+    iqueue_t batch;
+    TCB *thread;
+
+    if(!func || n < 0)
+        return -1;
+    if(n == 0)
+        return 0;
+    if(init_runtime())
+        return -1;
+
+    //a single critical section for the whole batch, which
+    //waits in @batch until it is complete
+    iqueue_init(&batch);
+    preempt_disable();
+    struct worker *worker = this_worker();
+    TCB *creator = worker->runningThread;
+    reap_dead_thread(worker);
+    for (int i = 0; i < n; ++i) {
+        thread = alloc_thread(UTHREAD_STACK_SIZE, false);
+        if(!thread || tid_alloc(thread)){
+            if(thread)
+                free_thread(thread);
+            //all or nothing
+            while((thread = dequeue_thread(&batch)) != NULL){
+                tid_free(thread->TID);
+                free_thread(thread);
+            }
+            preempt_enable();
+            return -1;
+        }
+        init_thread(thread, creator, func, args ? args[i] : NULL, false);
+        enqueue_thread(&batch, thread);
+    }
+
+    //what wake_thread() does, with the checks made once for the batch
+    struct run_queue *runQueue = &worker->runQueue;
+    TCB *first = NULL;
+    for (int i = 0; (thread = dequeue_thread(&batch)) != NULL; ++i) {
+        if(thread->vruntime < runQueue->minVruntime)
+            thread->vruntime = runQueue->minVruntime;
+        make_ready(runQueue, thread);
+        if(tids)
+            tids[i] = thread->TID;
+        if(!first)
+            first = thread;
+    }
+    if(threadScheduler->numIdle)
+        pthread_cond_broadcast(&threadScheduler->idleCond);
+    else
+        io_kick();
+    if(has_competition(runQueue, creator))
+        preempt_arm();
+    if(should_preempt(first, creator))
+        preempt_resched();
+
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * we dequeue runningThread and get the current thread
+ * we then dequeue readyThread and get the next thread
+ * call uthread_ctx_switch to switch context
+ */
+void uthread_yield(void)
+{
+    //nobody to yield to yet
+    if(!threadScheduler)
+        return;
+
+    preempt_disable();
+
+    run_timers(false);
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+    //give the worker back, see stop_workers()
+    if(threadScheduler->stopping){
+        make_ready(&worker->runQueue, currentThread);
+        dispatch_thread(currentThread, &worker->idleThread);
+        preempt_enable();
+        return;
+    }
+    //there is no thread of our priority or above that is ready
+    //to be executed, thread will continue running
+    if(!has_competition(&worker->runQueue, currentThread)){
+        //nobody to share the CPU with, stop ticking unless
+        //timers need to be fired or descriptors polled
+        if(!timer_wheel_count(&threadScheduler->timers) && !threadScheduler->io.numWaiters)
+            preempt_disarm();
+        currentThread->sliceLeft = slice_ticks(currentThread->prio);
+        preempt_enable();
+        return;
+    }
+    //else, we switch to next thread
+    TCB *nextThread = NULL;
+
+    //put currentThread in ready status and nextThread in running status
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR)
+        account_thread(currentThread, now_ns());
+    make_ready(&worker->runQueue, currentThread);
+    nextThread = pick_next_thread(&worker->runQueue);
+    //with the fair policy, we may still be the one who ran the least
+    if(nextThread == currentThread)
+        currentThread->sliceLeft = slice_ticks(currentThread->prio);
+    else
+        dispatch_thread(currentThread, nextThread);
+
+    preempt_enable();
+}
+
+/*
+ * called for every timer tick, the running thread
+ * only yields once its time slice is used up
+ */
+void uthread_tick(void)
 {
-    threadScheduler.readyThreads = queue_create();
-    threadScheduler.finishedThreads = queue_create();
-    threadScheduler.waitingThreads = queue_create();
+    preempt_disable();
+    //threads waiting for I/O or timers must not wait for
+    //everybody else to block
+    io_poll(false);
+    run_timers(false);
+    bool expired = --this_worker()->runningThread->sliceLeft <= 0;
+    preempt_enable();
+
+    if(expired)
+        uthread_yield();
+}
 
-    TCB *mainThread = malloc(sizeof(TCB));
-    if(!mainThread){
-        perror("malloc");
+int uthread_prio_config(int levels)
+{
+    //the run queue cannot change once threads use it
+    if(levels < 1 || levels > UTHREAD_PRIO_LEVELS_MAX || threadScheduler)
         return -1;
-    }
-    mainThread->TID = 0;
-    mainThread->retval = -1;
-    mainThread->isJoined = false; //it should be always false, main will not be joined by other
-    mainThread->waitingThreadTID = 0;
-    //I think we need to first malloc memory for ctx variable!
-    //Do we need to clear this memory?
-    mainThread->ctx = malloc(sizeof(uthread_ctx_t));
-    threadScheduler.runningThread = mainThread;
+    schedConfig.prioLevels = levels;
     return 0;
 }
 
-/*
- *  if it is the first time we call
- *  uthread_create in the main, we need to
- *  register main as a thread in threadScheduler
- */
-int uthread_create(uthread_func_t func, void *arg)
+int uthread_sched_config(uthread_sched_policy_t policy)
 {
-    TCB *newThread = malloc(sizeof(TCB));
-    if(!newThread){
-        perror("malloc");
+    if((policy != UTHREAD_SCHED_FIFO && policy != UTHREAD_SCHED_FAIR)
+    || threadScheduler)
         return -1;
-    }
-    newThread->retval = -1; //set minus 1 as its initial value
-    newThread->isJoined = false;
-    newThread->waitingThreadTID = 0;
+    schedConfig.policy = policy;
+    return 0;
+}
 
-    newThread->TID = threadScheduler.NEXT_TID;
-    //check if TID overflow
-    if(newThread->TID == 0)
+int uthread_workers_config(int workers)
+{
+    if(workers < 0 || threadScheduler)
         return -1;
+    schedConfig.workers = workers;
+    return 0;
+}
 
-    //check if it is our first time to call uthread_create
-    if(newThread->TID == 1){
-        add_main_thread_to_scheduler();
-        preempt_start();
+int uthread_prio_setslice(int prio, unsigned int ticks)
+{
+    //before initialization, the scheduler will copy it
+    preempt_disable();
+    struct sched_config *config = threadScheduler ? &threadScheduler->config : &schedConfig;
+    if(prio < 0 || prio >= config->prioLevels || ticks == 0){
+        preempt_enable();
+        return -1;
     }
+    config->prioSlice[prio] = ticks;
+    preempt_enable();
+    return 0;
+}
 
-    //I think we need to first malloc memory for ctx variable!
-    //Do we need to clear this memory?
-    uthread_ctx_t *ctx = malloc(sizeof(uthread_ctx_t));
-    void *sp = uthread_ctx_alloc_stack();
-    if(!sp){
-        perror("malloc");
+int uthread_setprio(uthread_t tid, int prio)
+{
+    if(init_runtime() || prio < 0 || prio >= threadScheduler->config.prioLevels)
         return -1;
-    }
 
-    if(uthread_ctx_init(ctx, sp, func, arg) == -1){
-        printf("Fail to initialize context for thread %d\n", newThread->TID);
+    preempt_disable();
+    TCB *thread = tid_lookup(tid);
+    if(!thread || thread->isFinished){
+        preempt_enable();
         return -1;
     }
-    newThread->ctx = ctx;
+    //a ready thread moves to the tail of its new level
+    if(thread->isReady){
+        struct run_queue *runQueue = thread->runQueue;
+        remove_ready(thread);
+        thread->prio = prio;
+        make_ready(runQueue, thread);
+    }else{
+        thread->prio = prio;
+    }
 
-    //disable preempt when change threadScheduler
-    preempt_disable();
+    //the running thread may not be the most urgent anymore
+    struct worker *worker = this_worker();
+    TCB *running = worker->runningThread;
+    if(has_competition(&worker->runQueue, running))
+        preempt_arm();
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FIFO && highest_ready(&worker->runQueue) > running->prio)
+        preempt_resched();
+    preempt_enable();
+    return 0;
+}
 
-    queue_enqueue(threadScheduler.readyThreads, newThread);
-    ++(threadScheduler.NEXT_TID);
+int uthread_getprio(uthread_t tid)
+{
+    if(init_runtime())
+        return -1;
 
+    preempt_disable();
+    TCB *thread = tid_lookup(tid);
+    int prio = thread && !thread->isFinished ? thread->prio : -1;
     preempt_enable();
-
-    return newThread->TID;
+    return prio;
 }
 
-/*
- * we dequeue runningThread and get the current thread
- * we then dequeue readyThread and get the next thread
- * call uthread_ctx_switch to switch context
- */
-void uthread_yield(void)
+int uthread_setweight(uthread_t tid, unsigned int weight)
 {
-    int returnVal = queue_length(threadScheduler.readyThreads);
-    //there is no thread that is ready to be execute, thread will continue running;
-    if(returnVal == 0)
-        return;
-    //else, we switch to next thread
-    TCB *currentThread = threadScheduler.runningThread;
-    TCB *nextThread = NULL;
+    if(weight == 0 || weight > UTHREAD_WEIGHT_MAX || init_runtime())
+        return -1;
 
     preempt_disable();
-    //put currentThread in ready status and nextThread in running status
-    queue_dequeue(threadScheduler.readyThreads, (void**)&nextThread);
-    queue_enqueue(threadScheduler.readyThreads, currentThread);
-    threadScheduler.runningThread = nextThread;
-    uthread_ctx_switch(currentThread->ctx, nextThread->ctx);
-
+    TCB *thread = tid_lookup(tid);
+    if(!thread || thread->isFinished){
+        preempt_enable();
+        return -1;
+    }
+    //the time run so far is charged at the old weight
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR && thread == this_worker()->runningThread)
+        account_thread(thread, now_ns());
+    thread->weight = weight;
     preempt_enable();
+    return 0;
 }
 
-uthread_t uthread_self(void)
+int uthread_getweight(uthread_t tid)
 {
-    return threadScheduler.runningThread->TID;
+    if(init_runtime())
+        return -1;
+
+    preempt_disable();
+    TCB *thread = tid_lookup(tid);
+    int weight = thread && !thread->isFinished ? (int)thread->weight : -1;
+    preempt_enable();
+    return weight;
 }
 
-/*
- * find data->TID == arg
- */
-int find_thread(void *data, void *arg)
+uthread_t uthread_self(void)
 {
-    if(!data)
+    //main is thread 0, even before the library is initialized
+    if(!threadScheduler)
         return 0;
-
-    TCB *ele = (TCB *)data;
-    uthread_t *dest = (uthread_t *)arg;
-    if(ele->TID == *dest)
-        return 1;
-    return 0;
+    //we must not move to another worker while looking
+    preempt_disable();
+    uthread_t tid = this_worker()->runningThread->TID;
+    preempt_enable();
+    return tid;
 }
 
 /*
@@ -178,46 +1641,164 @@ int find_thread(void *data, void *arg)
  * if there is still element inside myQueue
  * we also free that element
  */
-void destroy_queue(queue_t myQueue)
+void destroy_queue(iqueue_t *myQueue)
 {
     TCB *tmp;
-    while(queue_length(myQueue) != 0){
-        queue_dequeue(myQueue, (void**)&tmp);
-        uthread_ctx_destroy_stack(tmp->ctx->uc_stack.ss_sp);
-        free(tmp->ctx);
-        free(tmp);
+    while((tmp = dequeue_thread(myQueue)) != NULL){
+        free_thread(tmp);
     }
-    queue_destroy(myQueue);
 }
 
 /*
  * we need to bring that thread back to ready list
  * so that it can collect exit status of current thread
+ * must be called with preemption disabled
  */
 void activate_waiting_thread(uthread_t tid)
 {
-    TCB *waitingThread = NULL;
+    TCB *waitingThread = tid_lookup(tid);
+    //it timed out, and collects us when it runs
+    if(waitingThread->timedOut)
+        return;
+    iqueue_remove(&threadScheduler->waitingThreads, &waitingThread->link);
+    //it no longer needs its timeout
+    timer_wheel_cancel(&threadScheduler->timers, &waitingThread->timer);
+    waitingThread->waitQueue = NULL;
+    wake_thread(waitingThread);
+}
 
-    preempt_disable();
+/*
+ * finish @thread, which could not be started, as if it
+ * had returned -1 right away: too late to tell its
+ * creator, but its joiner gets to know
+ * must be called with preemption disabled
+ */
+static void abort_thread(TCB *thread)
+{
+    if(thread->isJoined)
+        activate_waiting_thread(thread->waitingThreadTID);
+    thread->retval = -1;
+    thread->isFinished = true;
+    if(thread->isDetached){
+        //nothing ever ran on it, it can go right away
+        tid_free(thread->TID);
+        free_thread(thread);
+    }else{
+        enqueue_thread(&threadScheduler->finishedThreads, thread);
+    }
+}
 
-    queue_iterate(threadScheduler.waitingThreads, find_thread, (void*)&tid, (void**)&waitingThread);
-    queue_delete(threadScheduler.waitingThreads, waitingThread);
-    queue_enqueue(threadScheduler.readyThreads, waitingThread);
+/*
+ * stop the other workers of the scheduler of the calling
+ * kernel thread, and wait for their kernel threads to exit
+ * the threads they run are left where they are, until they
+ * block, yield or finish, and never run again after that
+ * must be called by main, with preemption enabled
+ */
+static void stop_workers(void)
+{
+    sigset_t tick;
 
+    //main must not switch to anybody anymore
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGVTALRM);
+    pthread_sigmask(SIG_BLOCK, &tick, NULL);
+    preempt_disable();
+    preempt_forget();
+    threadScheduler->stopping = true;
+    pthread_cond_broadcast(&threadScheduler->idleCond);
+    io_kick();
     preempt_enable();
+
+    for (int i = 1; i < threadScheduler->numWorkers; ++i)
+        pthread_join(threadScheduler->workers[i].pthread, NULL);
+    pthread_sigmask(SIG_UNBLOCK, &tick, NULL);
 }
 
-void exit_program()
+/*
+ * free the scheduler of the calling kernel thread, and
+ * every thread left in it
+ * must be called by main, once the other workers, if
+ * any, are stopped
+ */
+static void destroy_runtime(void)
 {
     //we dont want to switch context when we are cleaning up
     preempt_disable();
 
-    destroy_queue(threadScheduler.readyThreads);
-    destroy_queue(threadScheduler.waitingThreads);
-    destroy_queue(threadScheduler.finishedThreads);
-    uthread_ctx_destroy_stack(threadScheduler.runningThread->ctx->uc_stack.ss_sp);
-    free(threadScheduler.runningThread->ctx);
-    free(threadScheduler.runningThread);
+    struct worker *worker = this_worker();
+    TCB *readyThread;
+    for (int i = 0; i < threadScheduler->numWorkers; ++i) {
+        struct worker *other = &threadScheduler->workers[i];
+        while((readyThread = pick_next_thread(&other->runQueue)) != NULL)
+            free_thread(readyThread);
+        reap_dead_thread(other);
+    }
+    //sleeping threads are only in the timer wheel, the
+    //others are freed from the queue they wait in
+    wheel_timer_t *timer;
+    while((timer = timer_wheel_expire(&threadScheduler->timers, UINT64_MAX)) != NULL){
+        TCB *thread = timer_wheel_entry(timer, TCB, timer);
+        if(!thread->waitQueue)
+            free_thread(thread);
+    }
+    destroy_queue(&threadScheduler->waitingThreads);
+    destroy_queue(&threadScheduler->finishedThreads);
+    struct io_poller *io = &threadScheduler->io;
+    for (int fd = 0; fd < io->numFds; ++fd) {
+        if(!io->fds[fd])
+            continue;
+        destroy_queue(&io->fds[fd]->waiters[IO_READ]);
+        destroy_queue(&io->fds[fd]->waiters[IO_WRITE]);
+        free(io->fds[fd]);
+    }
+    free(io->fds);
+    if(io->started){
+        close(io->epollFd);
+        close(io->wakeFd);
+    }
+    free_thread(worker->runningThread);
+    uthread_ctx_destroy_stack(threadScheduler->sharedStack.stack, threadScheduler->sharedStack.stackSize);
+    uthread_ctx_destroy_stack(threadScheduler->sharedStack.switcherStack, threadScheduler->sharedStack.switcherStackSize);
+    uthread_ctx_destroy_stack(worker->idleThread.stack, worker->idleThread.stackSize);
+    slab_destroy(threadScheduler->tcbSlab);
+    free(threadScheduler->tidTable.slots);
+
+    preempt_enable();
+    preempt_stop();
+    if(threadScheduler->numWorkers > 1){
+        pthread_mutex_destroy(&threadScheduler->lock);
+        pthread_cond_destroy(&threadScheduler->idleCond);
+    }
+    free(threadScheduler->workers);
+    free(threadScheduler);
+    threadScheduler = NULL;
+    thisWorker = NULL;
+}
+
+/*
+ * called when a kernel thread which initialized the
+ * library exits, with its scheduler
+ * the scheduler is only freed if nothing else can use it
+ */
+static void runtime_key_destructor(void *arg)
+{
+    if(threadScheduler != arg
+    || this_worker()->runningThread != &threadScheduler->mainTCB)
+        return;
+    if(threadScheduler->numWorkers > 1)
+        stop_workers();
+    destroy_runtime();
+    //give the idle stacks of our pool back as well
+    uthread_stack_pool_config(0, 0);
+}
+
+void exit_program()
+{
+    //the other workers may still be running threads,
+    //leave everything to the system
+    if(threadScheduler && threadScheduler->numWorkers == 1)
+        destroy_runtime();
     exit(EXIT_SUCCESS);
 }
 
@@ -229,25 +1810,39 @@ void exit_program()
  */
 void uthread_exit(int retval)
 {
-    TCB *currentThread = threadScheduler.runningThread;
     //if current thread is main
     //we free everything and quit
-    if(currentThread->TID == 0)
+    if(uthread_self() == 0)
         exit_program();
 
-    //if there is a thread waiting current thread
-    if(currentThread->isJoined)
-        activate_waiting_thread(currentThread->waitingThreadTID);
-
     TCB *nextThread = NULL;
 
+    //the joining thread must not run before we are
+    //in the finished list
     preempt_disable();
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+
+    //if there is a thread waiting current thread
+    if(currentThread->isJoined)
+        activate_waiting_thread(currentThread->waitingThreadTID);
 
-    queue_dequeue(threadScheduler.readyThreads, (void**)&nextThread);
+    nextThread = next_thread(worker);
     currentThread->retval = retval;
-    queue_enqueue(threadScheduler.finishedThreads, currentThread);
-    threadScheduler.runningThread = nextThread;
-    uthread_ctx_switch(currentThread->ctx, nextThread->ctx);
+    currentThread->isFinished = true;
+    if(currentThread->isDetached){
+        //nobody will collect us: our TID is free right away, the
+        //rest once we are off our stack
+        tid_free(currentThread->TID);
+        reap_dead_thread(worker);
+        worker->deadThread = currentThread;
+    }else{
+        enqueue_thread(&threadScheduler->finishedThreads, currentThread);
+    }
+    //our frames on the shared stack are dead, no need to save them
+    if(threadScheduler->sharedStack.owner == currentThread)
+        threadScheduler->sharedStack.owner = NULL;
+    dispatch_thread(currentThread, nextThread);
 
     preempt_enable();
 }
@@ -263,12 +1858,11 @@ int reap_sthread(TCB *reapedThread)
 {
     preempt_disable();
 
-    queue_delete(threadScheduler.finishedThreads, reapedThread);
+    iqueue_remove(&threadScheduler->finishedThreads, &reapedThread->link);
+    tid_free(reapedThread->TID);
     int retval = reapedThread->retval;
     //free the memory allocated for reapedThread
-    uthread_ctx_destroy_stack(reapedThread->ctx->uc_stack.ss_sp);
-    free(reapedThread->ctx);
-    free(reapedThread);
+    free_thread(reapedThread);
 
     preempt_enable();
     return retval;
@@ -279,26 +1873,30 @@ int reap_sthread(TCB *reapedThread)
  * and we search the next thread inside ready list
  * and we put next thread into waiting list and switch
  * context.
+ * if @timed is set, we stop waiting at @deadline
+ * Return value:
+ * as for uthread_join_timeout()
  */
-int uthread_join(uthread_t tid, int *retval)
+static int join_thread(uthread_t tid, int *retval, bool timed, uint64_t deadline)
 {
-    if(tid == 0 || tid == uthread_self() || tid >= threadScheduler.NEXT_TID)
+    if(tid == 0 || !threadScheduler || tid == uthread_self())
         return -1;
-    //we first need to check if @tid is finished
-    //if it is, we can directly collect it finished status and return
-    TCB *threadTID = NULL;
-    TCB *currentThread = threadScheduler.runningThread;
-
+    //@tid must not finish between our checks and the
+    //moment we block
     preempt_disable();
-    queue_iterate(threadScheduler.finishedThreads, find_thread, (void*)&tid, (void**)&threadTID);
-    preempt_enable();
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+    TCB *threadTID = tid_lookup(tid);
 
-    if(threadTID){
-        //thread already be joined
-        if(threadTID->isJoined)
-            return -1;
-        //thread is not be joined
-        preempt_disable();
+    //fail to find @tid, or thread already be joined or detached
+    if(!threadTID || threadTID->isJoined || threadTID->isDetached){
+        preempt_enable();
+        return -1;
+    }
+
+    //we first need to check if @tid is finished
+    //if it is, we can directly collect it finished status and return
+    if(threadTID->isFinished){
         threadTID->isJoined = true;
         threadTID->waitingThreadTID = currentThread->TID;
         preempt_enable();
@@ -311,25 +1909,18 @@ int uthread_join(uthread_t tid, int *retval)
 
     //if @tid is still an active thread
     //current thread should be blocked and yield
-    preempt_disable();
-    queue_iterate(threadScheduler.readyThreads, find_thread, (void*)&tid, (void**)&threadTID);
-    preempt_enable();
-    //fail to find @tid thread in ready list
-    if(!threadTID){
-        preempt_disable();
-        queue_iterate(threadScheduler.waitingThreads, find_thread, (void*)&tid, (void**)&threadTID);
+    TCB *nextThread = NULL;
+
+    //no need to block if we would not wait at all
+    if(timed && deadline <= now_ns()){
         preempt_enable();
-        //fail to find @tid in waiting list
-        if(!threadTID)
-            return -1;
+        return 1;
     }
-
-    //find @tid
-    if(threadTID->isJoined)
+    currentThread->timedOut = false;
+    if(timed && arm_timer(currentThread, deadline, &threadScheduler->waitingThreads)){
+        preempt_enable();
         return -1;
-    TCB *nextThread = NULL;
-
-    preempt_disable();
+    }
 
     //@tid is not joined be other thread, we need to mark it
     threadTID->isJoined = true;
@@ -337,14 +1928,21 @@ int uthread_join(uthread_t tid, int *retval)
     //we put current thread into the waiting list
     //block it until threadTID finish its execution
     threadTID->waitingThreadTID = currentThread->TID;
-    queue_enqueue(threadScheduler.waitingThreads, currentThread);
+    enqueue_thread(&threadScheduler->waitingThreads, currentThread);
 
     //bring next readyThread to execute
-    queue_dequeue(threadScheduler.readyThreads, (void**)&nextThread);
-    threadScheduler.runningThread = nextThread;
+    nextThread = next_thread(worker);
     //switch context to next ready thread
-    uthread_ctx_switch(currentThread->ctx, nextThread->ctx);
+    if(nextThread != currentThread)
+        dispatch_thread(currentThread, nextThread);
 
+    //we gave up, someone else may join @tid now, unless it
+    //finished in the meantime
+    if(currentThread->timedOut && !threadTID->isFinished){
+        threadTID->isJoined = false;
+        preempt_enable();
+        return 1;
+    }
     preempt_enable();
 
     //when currentThread is resumed, threadTID should already be finished
@@ -353,4 +1951,240 @@ int uthread_join(uthread_t tid, int *retval)
     if(retval)
         *retval = tmp;
     return 0;
-}
\ No newline at end of file
+}
+/*
+ * get ready to run an I/O operation on @fd for @dir:
+ * make @fd non-blocking, so that the operation cannot
+ * block the kernel thread, and get the sequence number
+ * of its readiness events in @seq
+ * Return value:
+ * -1 if failure, 0 if success
+ */
+static int io_begin(int fd, int dir, uint32_t *seq)
+{
+    if(init_runtime())
+        return -1;
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0)
+        return -1;
+    if(!(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return -1;
+
+    preempt_disable();
+    struct io_wait *wait = io_entry(fd);
+    if(wait)
+        *seq = wait->seq[dir];
+    preempt_enable();
+    if(!wait){
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * block the running thread until @fd is ready for @dir,
+ * unless it became ready since its sequence number was
+ * @seq, which then receives the new sequence number
+ * Return value:
+ * -1 if @fd cannot be waited for, 0 otherwise
+ */
+static int io_park(int fd, int dir, uint32_t *seq)
+{
+    preempt_disable();
+    struct io_wait *wait = threadScheduler->io.fds[fd];
+
+    //edges which came before are reported right away
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.fd = fd,
+    };
+    if(io_start() || (epoll_ctl(threadScheduler->io.epollFd, EPOLL_CTL_ADD, fd, &event) < 0
+                      && errno != EEXIST)){
+        //errno is per kernel thread, we may move
+        int error = errno;
+        preempt_enable();
+        errno = error;
+        return -1;
+    }
+    io_poll(false);
+
+    if(wait->seq[dir] == *seq){
+        struct worker *worker = this_worker();
+        TCB *currentThread = worker->runningThread;
+        enqueue_thread(&wait->waiters[dir], currentThread);
+        threadScheduler->io.numWaiters++;
+        //a thread running alone needs ticks to poll for us
+        preempt_arm();
+
+        //we may be the next one, if nothing else runs
+        TCB *nextThread = next_thread(worker);
+        if(nextThread != currentThread)
+            dispatch_thread(currentThread, nextThread);
+    }
+
+    *seq = wait->seq[dir];
+    preempt_enable();
+    return 0;
+}
+
+/*
+ * whether an I/O operation on @fd which failed should
+ * be tried again, after waiting for @fd if needed
+ */
+static bool io_again(int fd, int dir, uint32_t *seq)
+{
+    if(errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+    return !io_park(fd, dir, seq);
+}
+
+ssize_t uthread_read(int fd, void *buf, size_t count)
+{
+    uint32_t seq;
+    ssize_t ret;
+
+    if(io_begin(fd, IO_READ, &seq))
+        return -1;
+    while((ret = read(fd, buf, count)) < 0 && io_again(fd, IO_READ, &seq))
+        ;
+    return ret;
+}
+
+ssize_t uthread_write(int fd, const void *buf, size_t count)
+{
+    uint32_t seq;
+    ssize_t ret;
+
+    if(io_begin(fd, IO_WRITE, &seq))
+        return -1;
+    while((ret = write(fd, buf, count)) < 0 && io_again(fd, IO_WRITE, &seq))
+        ;
+    return ret;
+}
+
+int uthread_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+    uint32_t seq;
+    int ret;
+
+    if(io_begin(sockfd, IO_READ, &seq))
+        return -1;
+    while((ret = accept4(sockfd, addr, addrlen, SOCK_NONBLOCK)) < 0
+          && io_again(sockfd, IO_READ, &seq))
+        ;
+    return ret;
+}
+
+int uthread_detach(uthread_t tid)
+{
+    if(tid == 0 || !threadScheduler)
+        return -1;
+
+    preempt_disable();
+    TCB *thread = tid_lookup(tid);
+    //a joining thread already counts on collecting it
+    if(!thread || thread->isJoined || thread->isDetached){
+        preempt_enable();
+        return -1;
+    }
+    thread->isDetached = true;
+    //once we let go, it would free itself if it was not finished
+    bool finished = thread->isFinished;
+    preempt_enable();
+
+    //nothing left to wait for
+    if(finished)
+        reap_sthread(thread);
+    return 0;
+}
+
+int uthread_join(uthread_t tid, int *retval)
+{
+    return join_thread(tid, retval, false, 0);
+}
+
+void sched_block(iqueue_t *queue)
+{
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+
+    enqueue_thread(queue, currentThread);
+    TCB *nextThread = next_thread(worker);
+    dispatch_thread(currentThread, nextThread);
+}
+
+void sched_wake(iqueue_link_t *link)
+{
+    wake_thread(iqueue_entry(link, TCB, link));
+}
+
+void sched_handoff(iqueue_link_t *link)
+{
+    TCB *thread = iqueue_entry(link, TCB, link);
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+
+    if(ready_queue(thread) != &worker->runQueue
+    || (threadScheduler->config.policy == UTHREAD_SCHED_FIFO && thread->prio < currentThread->prio)){
+        wake_thread(thread);
+        return;
+    }
+    //no credit for the time spent blocked
+    if(thread->vruntime < worker->runQueue.minVruntime)
+        thread->vruntime = worker->runQueue.minVruntime;
+    if(threadScheduler->config.policy == UTHREAD_SCHED_FAIR)
+        account_thread(currentThread, now_ns());
+    make_ready(&worker->runQueue, currentThread);
+    dispatch_thread(currentThread, thread);
+}
+
+bool sched_shared_stack(void)
+{
+    bool shared;
+
+    preempt_disable();
+    shared = threadScheduler && this_worker()->runningThread->sharedStack;
+    preempt_enable();
+    return shared;
+}
+
+/*
+ * the time @ns from now, far enough if that overflows
+ */
+static uint64_t deadline_after(uint64_t ns)
+{
+    uint64_t now = now_ns();
+    return ns < UINT64_MAX - now ? now + ns : UINT64_MAX - 1;
+}
+
+int uthread_join_timeout(uthread_t tid, int *retval, uint64_t timeout_ns)
+{
+    return join_thread(tid, retval, true, deadline_after(timeout_ns));
+}
+
+int uthread_sleep_ns(uint64_t ns)
+{
+    if(init_runtime())
+        return -1;
+    if(!ns){
+        uthread_yield();
+        return 0;
+    }
+    uint64_t deadline = deadline_after(ns);
+
+    preempt_disable();
+    struct worker *worker = this_worker();
+    TCB *currentThread = worker->runningThread;
+    if(arm_timer(currentThread, deadline, NULL)){
+        preempt_enable();
+        return -1;
+    }
+    //our own timer may be the next thing to happen
+    TCB *nextThread = next_thread(worker);
+    if(nextThread != currentThread)
+        dispatch_thread(currentThread, nextThread);
+    preempt_enable();
+    return 0;
+}
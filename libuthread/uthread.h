@@ -1,16 +1,37 @@
 #ifndef _UTHREAD_H
 #define _UTHREAD_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/*
+ * Every kernel thread (pthread) using the library gets an independent
+ * scheduler of its own, the first time it calls uthread_create() or another
+ * function needing one. The threads it creates only ever run on that kernel
+ * thread, or on the workers it starts (see uthread_workers_config()), and
+ * nothing is shared with the schedulers of other kernel threads: TIDs,
+ * settings, and preemption timers are all per scheduler. The calling kernel
+ * thread itself becomes the 'main' thread of its scheduler. A scheduler is
+ * freed when its kernel thread exits, with the threads left in it: its other
+ * workers exit first, once the threads they are running block, yield or
+ * finish.
+ */
+
 /*
  * uthread_t - Thread identifier (TID) type
  *
- * Each user thread is assigned a different TID. TID are assigned in increasing
- * order and numbered starting from 1 (apart from the 'main' thread who
- * automatically gets TID #0). Overflowing the current TID value is considered a
- * case of failure (in other words, it is impossible to create more than
- * USHRT_MAX threads).
+ * Each live user thread is assigned a different TID, the 'main' thread
+ * automatically getting TID #0. A TID is released once its thread has been
+ * joined, and may then be handed out again with a different value: the first
+ * threads are numbered 1, 2, 3, etc. and later ones reuse released numbers
+ * tagged with a new generation. There is no limit on the number of threads
+ * created over the lifetime of a program, but at most about a million threads
+ * can be alive (running, ready, blocked or not yet joined) at the same time.
+ * A TID always fits in a positive int.
  */
-typedef unsigned short uthread_t;
+typedef uint32_t uthread_t;
 
 /*
  * uthread_func_t - Thread function type
@@ -20,6 +41,284 @@ typedef unsigned short uthread_t;
  */
 typedef int (*uthread_func_t)(void *arg);
 
+/*
+ * UTHREAD_STACK_SIZE - Default size of a thread's stack (in bytes)
+ * UTHREAD_STACK_MIN - Smallest stack size a thread can be created with
+ */
+#define UTHREAD_STACK_SIZE 32768
+#define UTHREAD_STACK_MIN 8192
+
+/*
+ * uthread_attr_t - Thread creation attributes
+ *
+ * Attributes must be initialized with uthread_attr_init() before being
+ * modified with the uthread_attr_set*() functions, and are then passed to
+ * uthread_create_attr(). The same attributes can be used to create any number
+ * of threads.
+ */
+typedef struct uthread_attr {
+	size_t stacksize;
+	int sharedstack;
+	int detached;
+} uthread_attr_t;
+
+/*
+ * uthread_attr_init - Initialize thread attributes with default values
+ * @attr: Attributes to initialize
+ *
+ * Return: -1 if @attr is NULL, 0 otherwise
+ */
+int uthread_attr_init(uthread_attr_t *attr);
+
+/*
+ * uthread_attr_setstacksize - Set the stack size attribute
+ * @attr: Attributes to modify
+ * @stacksize: Size of the stack (in bytes)
+ *
+ * The stack is reserved but memory is only committed for the pages the thread
+ * actually touches, so a large stack is cheap if it is mostly unused. The size
+ * is rounded up by the library and an inaccessible guard page is placed below
+ * the stack, so that a stack overflow crashes the program rather than
+ * corrupting memory. The stack is only allocated when the thread first runs,
+ * its control block lives apart from it.
+ *
+ * Return: -1 if @attr is NULL or if @stacksize is smaller than
+ * UTHREAD_STACK_MIN, 0 otherwise
+ */
+int uthread_attr_setstacksize(uthread_attr_t *attr, size_t stacksize);
+
+/*
+ * uthread_attr_setsharedstack - Set the shared stack attribute
+ * @attr: Attributes to modify
+ * @sharedstack: 1 to run the thread on the shared stack, 0 to give it its own
+ *	stack (default)
+ *
+ * All the threads created with this attribute run on one large stack shared
+ * with each other. When such a thread is switched out and another one needs
+ * the shared stack, the part of its stack actually in use is copied out to a
+ * heap buffer of the same size, and copied back before it resumes. A parked
+ * thread thus only costs as much memory as its real stack depth, at the price
+ * of a copy when switching between two shared-stack threads. The stack size
+ * attribute is ignored for such threads.
+ *
+ * Pointers to a thread's stack variables are only valid while that thread
+ * runs: they must not be handed to other threads.
+ *
+ * Return: -1 if @attr is NULL or if shared stacks are not supported by this
+ * build of the library, 0 otherwise
+ */
+int uthread_attr_setsharedstack(uthread_attr_t *attr, int sharedstack);
+
+/*
+ * uthread_attr_setdetached - Set the detached attribute
+ * @attr: Attributes to modify
+ * @detached: 1 to create the thread detached, 0 to create it joinable
+ *	(default)
+ *
+ * A thread created with this attribute is detached from the start, as if
+ * uthread_detach() had been called on it right away.
+ *
+ * Return: -1 if @attr is NULL, 0 otherwise
+ */
+int uthread_attr_setdetached(uthread_attr_t *attr, int detached);
+
+/*
+ * uthread_preempt_clock_t - Clock measuring time slices
+ * @UTHREAD_PREEMPT_CPU: CPU time consumed by the kernel thread running the
+ *	threads (default)
+ * @UTHREAD_PREEMPT_MONOTONIC: Wall-clock time, including the time spent
+ *	sleeping or blocked in system calls
+ */
+typedef enum uthread_preempt_clock {
+	UTHREAD_PREEMPT_CPU,
+	UTHREAD_PREEMPT_MONOTONIC,
+} uthread_preempt_clock_t;
+
+/*
+ * uthread_preempt_config - Configure thread preemption
+ * @hz: Number of time slices per second, 0 to disable preemption
+ * @clock: Clock measuring the time slices
+ *
+ * The running thread is forcefully yielded at the end of each time slice, by
+ * default 100 times per second of CPU time. The timer only runs while another
+ * thread is ready to run, so a thread running alone is never interrupted. Each
+ * kernel thread has a timer of its own, which only interrupts that kernel
+ * thread. This function can be called at any time, before or after creating
+ * threads, and only applies to the calling kernel thread: workers started by
+ * the library take the settings of the kernel thread starting them.
+ *
+ * Return: -1 if @hz is greater than 1000000, if @clock is invalid, or if the
+ * timer could not be created or armed. 0 otherwise.
+ */
+int uthread_preempt_config(unsigned int hz, uthread_preempt_clock_t clock);
+
+/*
+ * UTHREAD_PRIO_LEVELS_MAX - Largest number of priority levels
+ * UTHREAD_PRIO_LEVELS_DEFAULT - Number of priority levels unless configured
+ */
+#define UTHREAD_PRIO_LEVELS_MAX 64
+#define UTHREAD_PRIO_LEVELS_DEFAULT 8
+
+/*
+ * uthread_prio_config - Configure the number of priority levels
+ * @levels: Number of priority levels
+ *
+ * Priorities range from 0 (least urgent) to @levels - 1 (most urgent). The
+ * 'main' thread starts at priority @levels / 2, and a new thread starts with
+ * the priority of the thread creating it. A ready thread only runs when no
+ * thread of a higher priority is ready, and threads of the same priority take
+ * turns. This function must be called before any other function of the
+ * library, except for uthread_preempt_config(), uthread_sched_config(),
+ * uthread_workers_config() and the uthread_attr_*() functions.
+ *
+ * Return: -1 if @levels is smaller than 1 or greater than
+ * UTHREAD_PRIO_LEVELS_MAX, or if the library is already initialized. 0
+ * otherwise.
+ */
+int uthread_prio_config(int levels);
+
+/*
+ * uthread_sched_policy_t - Scheduling policy
+ * @UTHREAD_SCHED_FIFO: The most urgent ready thread runs first, and threads of
+ *	the same priority run in turn, in FIFO order (default)
+ * @UTHREAD_SCHED_FAIR: The ready thread which has run the least runs first.
+ *	Run times are scaled by the weight of each thread, so that over time each
+ *	thread gets a share of the CPU proportional to its weight. Priorities only
+ *	select the time slice.
+ */
+typedef enum uthread_sched_policy {
+	UTHREAD_SCHED_FIFO,
+	UTHREAD_SCHED_FAIR,
+} uthread_sched_policy_t;
+
+/*
+ * uthread_sched_config - Select the scheduling policy
+ * @policy: Scheduling policy
+ *
+ * Like uthread_prio_config(), this function must be called before the library
+ * is initialized.
+ *
+ * Return: -1 if @policy is invalid or if the library is already initialized, 0
+ * otherwise
+ */
+int uthread_sched_config(uthread_sched_policy_t policy);
+
+/*
+ * uthread_workers_config - Configure the number of kernel threads
+ * @workers: Number of kernel threads running user threads, 0 for one per
+ *	online CPU
+ *
+ * By default, all the threads run on the kernel thread which initializes the
+ * library. With several workers, each worker runs the threads queued on it,
+ * and a worker running out of threads steals ready threads from the others,
+ * sleeping when there are none. A new or woken up thread is queued on the
+ * worker of the thread creating or waking it up. A thread may thus resume on
+ * another kernel thread each time it yields or blocks: thread-local variables
+ * and errno must not be relied upon across such calls. The 'main' thread is
+ * the exception, it always runs on the kernel thread which initialized the
+ * library. Priorities only order the threads queued on the same worker, and
+ * shared stacks are not available. Like uthread_prio_config(), this function
+ * must be called before the library is initialized.
+ *
+ * Return: -1 if @workers is negative or if the library is already
+ * initialized, 0 otherwise
+ */
+int uthread_workers_config(int workers);
+
+/*
+ * uthread_stack_pool_config - Configure the stack pool
+ * @high_water: Maximum number of idle stacks to keep for reuse in each size
+ *	class (0 disables the pool)
+ * @prefill: Number of idle stacks of the default size (UTHREAD_STACK_SIZE) to
+ *	allocate right away, capped at @high_water
+ *
+ * The stacks of finished threads are kept in a pool, by size class, and given
+ * to new threads. Idle stacks above the new high-water mark are released. Only
+ * the pool of the calling kernel thread is configured.
+ *
+ * Return: -1 in case of memory allocation failure, 0 otherwise
+ */
+int uthread_stack_pool_config(size_t high_water, size_t prefill);
+
+/*
+ * uthread_stack_pool_trim - Give the memory of idle stacks back to the kernel
+ *
+ * The idle stacks of the pool of the calling kernel thread stay in the pool,
+ * but their pages are dropped with madvise(MADV_DONTNEED) and will be faulted
+ * back in, zeroed, when reused. The library never does this by itself: the
+ * pool only holds on to as many stacks as its high-water mark, and it is up to
+ * the application to trim it, e.g. after a burst of threads.
+ */
+void uthread_stack_pool_trim(void);
+
+/*
+ * uthread_prio_setslice - Set the time slice of a priority level
+ * @prio: Priority level
+ * @ticks: Length of the time slice, in preemption timer ticks
+ *
+ * A thread of priority @prio is preempted after running for @ticks ticks in a
+ * row, if another thread of the same priority is ready. The default is one
+ * tick. Longer slices for low priorities make for fewer, cheaper switches
+ * between background threads. The new slice applies from the next time such a
+ * thread is scheduled.
+ *
+ * Return: -1 if @prio is not a valid priority or if @ticks is 0, 0 otherwise
+ */
+int uthread_prio_setslice(int prio, unsigned int ticks);
+
+/*
+ * uthread_setprio - Set the priority of a thread
+ * @tid: TID of the thread
+ * @prio: New priority
+ *
+ * If a thread more urgent than the calling thread is ready as a result, the
+ * calling thread yields right away.
+ *
+ * Return: -1 if @prio is not a valid priority, or if thread @tid cannot be
+ * found or has finished. 0 otherwise.
+ */
+int uthread_setprio(uthread_t tid, int prio);
+
+/*
+ * uthread_getprio - Get the priority of a thread
+ * @tid: TID of the thread
+ *
+ * Return: -1 if thread @tid cannot be found or has finished, the priority of
+ * thread @tid otherwise
+ */
+int uthread_getprio(uthread_t tid);
+
+/*
+ * UTHREAD_WEIGHT_DEFAULT - Weight of the 'main' thread
+ * UTHREAD_WEIGHT_MAX - Largest thread weight
+ */
+#define UTHREAD_WEIGHT_DEFAULT 1024
+#define UTHREAD_WEIGHT_MAX (1 << 20)
+
+/*
+ * uthread_setweight - Set the weight of a thread
+ * @tid: TID of the thread
+ * @weight: New weight
+ *
+ * With the UTHREAD_SCHED_FAIR policy, a thread of weight 2048 gets twice as
+ * much CPU time as a thread of the default weight when both are always ready.
+ * A new thread starts with the weight of the thread creating it. Weights are
+ * kept but have no effect with the UTHREAD_SCHED_FIFO policy.
+ *
+ * Return: -1 if @weight is 0 or greater than UTHREAD_WEIGHT_MAX, or if thread
+ * @tid cannot be found or has finished. 0 otherwise.
+ */
+int uthread_setweight(uthread_t tid, unsigned int weight);
+
+/*
+ * uthread_getweight - Get the weight of a thread
+ * @tid: TID of the thread
+ *
+ * Return: -1 if thread @tid cannot be found or has finished, the weight of
+ * thread @tid otherwise
+ */
+int uthread_getweight(uthread_t tid);
+
 /*
  * uthread_create - Create a new thread
  * @func: Function to be executed by the thread
@@ -28,11 +327,46 @@ typedef int (*uthread_func_t)(void *arg);
  * This function creates a new thread running the function @func to which
  * argument @arg is passed, and returns the TID of this new thread.
  *
- * Return: -1 in case of failure (memory allocation, context creation, TID
- * overflow, etc.). The TID of the new thread otherwise.
+ * The stack and the execution context of the thread are only set up when it
+ * first runs: until then, it costs little more than its control block. If its
+ * stack cannot be allocated at that point, the thread finishes right away with
+ * -1 as its return value, without running @func.
+ *
+ * Return: -1 in case of failure (memory allocation, context creation, too
+ * many live threads, etc.). The TID of the new thread otherwise.
  */
 int uthread_create(uthread_func_t func, void *arg);
 
+/*
+ * uthread_create_attr - Create a new thread with specific attributes
+ * @func: Function to be executed by the thread
+ * @arg: Argument to be passed to the thread
+ * @attr: (Optional) Attributes of the new thread
+ *
+ * Same as uthread_create(), but the thread is created according to @attr. A
+ * NULL @attr means default attributes.
+ *
+ * Return: -1 in case of failure, the TID of the new thread otherwise
+ */
+int uthread_create_attr(uthread_func_t func, void *arg,
+			const uthread_attr_t *attr);
+
+/*
+ * uthread_create_n - Create several threads at once
+ * @func: Function to be executed by the threads
+ * @args: (Optional) Array of @n arguments, one for each thread
+ * @n: Number of threads to create
+ * @tids: (Optional) Array receiving the @n TIDs of the new threads
+ *
+ * Same as calling uthread_create(@func, @args[i]) @n times, but cheaper: the
+ * threads are set up and made ready all together, in a single critical
+ * section. Thread i gets @args[i], or NULL if @args is NULL.
+ *
+ * Return: -1 if @func is NULL, if @n is negative, or in case of failure, in
+ * which case no thread is created. 0 otherwise
+ */
+int uthread_create_n(uthread_func_t func, void **args, int n, uthread_t *tids);
+
 /*
  * uthread_self - Get thread identifier
  *
@@ -44,7 +378,9 @@ uthread_t uthread_self(void);
  * uthread_yield - Yield execution
  *
  * This function is to be called from the currently active and running thread in
- * order to yield for other threads to execute.
+ * order to yield for other threads to execute. Only threads of the same or of a
+ * higher priority get to run: the calling thread keeps running if the only
+ * ready threads are less urgent.
  */
 void uthread_yield(void);
 
@@ -77,8 +413,518 @@ void uthread_exit(int retval);
  *
  * Return: -1 if @tid is 0 (the 'main' thread cannot be joined), if @tid is the
  * TID of the calling thread, if thread @tid cannot be found, or if thread @tid
- * is already being joined. 0 otherwise.
+ * is already being joined or is detached. 0 otherwise.
  */
 int uthread_join(uthread_t tid, int *retval);
 
+/*
+ * uthread_detach - Detach a thread
+ * @tid: TID of the thread to detach
+ *
+ * A finished thread keeps its stack and TID until it is joined. A detached
+ * thread can no longer be joined instead, and gives them back as soon as it
+ * finishes: its TID right away, and its stack as soon as its kernel thread has
+ * switched to another thread. The stack then goes back to the stack pool, if
+ * it has room for it. A thread which already finished is freed right away.
+ * Threads may detach themselves.
+ *
+ * Return: -1 if @tid is 0, if thread @tid cannot be found, or if thread @tid
+ * is already being joined or is already detached. 0 otherwise.
+ */
+int uthread_detach(uthread_t tid);
+
+/*
+ * uthread_join_timeout - Join a thread, waiting for a limited time
+ * @tid: TID of the thread to join
+ * @retval: Address of an integer that will receive the return value
+ * @timeout_ns: Longest time to wait for thread @tid (in nanoseconds)
+ *
+ * Same as uthread_join(), but the calling thread stops waiting once
+ * @timeout_ns have elapsed. Thread @tid is then no longer being joined, and
+ * can be joined again. A timeout of 0 only checks whether thread @tid is
+ * finished.
+ *
+ * Return: -1 in the cases of uthread_join(), 1 if thread @tid did not finish
+ * in time, 0 otherwise
+ */
+int uthread_join_timeout(uthread_t tid, int *retval, uint64_t timeout_ns);
+
+/*
+ * uthread_sleep_ns - Sleep
+ * @ns: Time to sleep (in nanoseconds)
+ *
+ * The calling thread blocks for at least @ns, while the other threads keep
+ * running, and becomes ready again at most about 65 microseconds after that
+ * time, as soon as its kernel thread switches threads or gets a timer tick.
+ * When no thread is ready to run, the kernel thread sleeps until the first
+ * sleeping thread wakes up. A sleep of 0 is the same as uthread_yield().
+ *
+ * Return: -1 in case of failure, 0 otherwise
+ */
+int uthread_sleep_ns(uint64_t ns);
+
+/*
+ * uthread_read - Read from a file descriptor
+ * @fd: File descriptor to read from
+ * @buf: Buffer receiving the data
+ * @count: Size of @buf (in bytes)
+ *
+ * Same as read(2), but only the calling thread blocks until data is available,
+ * while the other threads keep running. @fd is made non-blocking: this is
+ * meant for sockets, pipes and other descriptors which support epoll(7), not
+ * regular files. When no thread is ready to run, the kernel thread sleeps
+ * until a descriptor some thread waits for is ready.
+ *
+ * Return: -1 in case of failure, with errno set, the number of bytes read
+ * otherwise (0 at end of file)
+ */
+ssize_t uthread_read(int fd, void *buf, size_t count);
+
+/*
+ * uthread_write - Write to a file descriptor
+ * @fd: File descriptor to write to
+ * @buf: Data to write
+ * @count: Size of @buf (in bytes)
+ *
+ * Same as write(2), with the behavior of uthread_read(). As with a
+ * non-blocking write(2), fewer than @count bytes may be written.
+ *
+ * Return: -1 in case of failure, with errno set, the number of bytes written
+ * otherwise
+ */
+ssize_t uthread_write(int fd, const void *buf, size_t count);
+
+/*
+ * uthread_accept - Accept a connection on a socket
+ * @sockfd: Listening socket
+ * @addr: (Optional) Receives the address of the peer
+ * @addrlen: (Optional) Size of @addr, receives the size of the address
+ *
+ * Same as accept(2), with the behavior of uthread_read(). The new socket is
+ * non-blocking, ready to be used with uthread_read() and uthread_write().
+ *
+ * Return: -1 in case of failure, with errno set, the new socket otherwise
+ */
+int uthread_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+
+/*
+ * uthread_wait_queue_t - Queue of the threads waiting on an object
+ *
+ * Embedded in the mutexes, condition variables and semaphores below, so that
+ * they can be allocated anywhere, but only ever touched by the library.
+ */
+struct uthread_wait_link {
+	struct uthread_wait_link *prev;
+	struct uthread_wait_link *next;
+};
+
+typedef struct uthread_wait_queue {
+	struct uthread_wait_link head;
+	int length;
+} uthread_wait_queue_t;
+
+/*
+ * uthread_mutex_t - Mutex type
+ *
+ * A mutex is owned by at most one thread at a time. Threads waiting for it
+ * block in FIFO order, and unlocking it hands it over to the oldest one
+ * directly, which never has to compete for it again. Locking a free mutex or
+ * unlocking one nobody waits for is a single atomic operation, which does not
+ * involve the scheduler.
+ *
+ * Like the condition variables and semaphores below, a mutex must be
+ * initialized before use, and can only be used by the threads of a single
+ * scheduler (see the top of this file).
+ */
+typedef struct uthread_mutex {
+	int state;
+	uthread_wait_queue_t waiters;
+} uthread_mutex_t;
+
+/*
+ * uthread_mutex_init - Initialize a mutex, unlocked
+ * @mutex: Mutex to initialize
+ */
+void uthread_mutex_init(uthread_mutex_t *mutex);
+
+/*
+ * uthread_mutex_lock - Lock a mutex
+ * @mutex: Mutex to lock, which the calling thread must not own
+ *
+ * The calling thread blocks until it owns @mutex.
+ */
+void uthread_mutex_lock(uthread_mutex_t *mutex);
+
+/*
+ * uthread_mutex_trylock - Lock a mutex if it is free
+ * @mutex: Mutex to lock
+ *
+ * Return: -1 if @mutex is owned by a thread, 0 if the calling thread now owns
+ * it
+ */
+int uthread_mutex_trylock(uthread_mutex_t *mutex);
+
+/*
+ * uthread_mutex_unlock - Unlock a mutex
+ * @mutex: Mutex to unlock, which the calling thread must own
+ */
+void uthread_mutex_unlock(uthread_mutex_t *mutex);
+
+/*
+ * uthread_cond_t - Condition variable type
+ *
+ * Threads wait on a condition variable in FIFO order. A thread woken up by
+ * uthread_cond_signal() or uthread_cond_broadcast() is queued on the mutex it
+ * waited with, unless the mutex is free, and owns it once it runs again.
+ */
+typedef struct uthread_cond {
+	uthread_wait_queue_t waiters;
+	uthread_mutex_t *mutex; /* the waiters' */
+} uthread_cond_t;
+
+/*
+ * uthread_cond_init - Initialize a condition variable
+ * @cond: Condition variable to initialize
+ */
+void uthread_cond_init(uthread_cond_t *cond);
+
+/*
+ * uthread_cond_wait - Wait on a condition variable
+ * @cond: Condition variable to wait on
+ * @mutex: Mutex owned by the calling thread, the same for all the threads
+ *	waiting on @cond
+ *
+ * Unlock @mutex and block the calling thread until @cond is signaled, both at
+ * once, and own @mutex again before returning.
+ */
+void uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex);
+
+/*
+ * uthread_cond_signal - Wake up the oldest thread waiting on a condition
+ * variable
+ * @cond: Condition variable to signal, nothing happens if no thread waits
+ */
+void uthread_cond_signal(uthread_cond_t *cond);
+
+/*
+ * uthread_cond_broadcast - Wake up all the threads waiting on a condition
+ * variable
+ * @cond: Condition variable to signal
+ */
+void uthread_cond_broadcast(uthread_cond_t *cond);
+
+/*
+ * uthread_sem_t - Semaphore type
+ *
+ * A semaphore counts resources. Threads waiting for one block in FIFO order,
+ * and a resource released while threads wait goes directly to the oldest one.
+ * Taking a resource which is available, or releasing one nobody waits for, is
+ * a single atomic operation, which does not involve the scheduler.
+ */
+typedef struct uthread_sem {
+	int count; /* minus the number of waiters when negative */
+	uthread_wait_queue_t waiters;
+	int handoffs; /* released to waiters not queued yet */
+} uthread_sem_t;
+
+/*
+ * uthread_sem_init - Initialize a semaphore
+ * @sem: Semaphore to initialize
+ * @count: Number of resources available
+ *
+ * Return: -1 if @count is negative, 0 otherwise
+ */
+int uthread_sem_init(uthread_sem_t *sem, int count);
+
+/*
+ * uthread_sem_down - Take a resource
+ * @sem: Semaphore to take a resource from
+ *
+ * The calling thread blocks until a resource is available.
+ */
+void uthread_sem_down(uthread_sem_t *sem);
+
+/*
+ * uthread_sem_trydown - Take a resource if one is available
+ * @sem: Semaphore to take a resource from
+ *
+ * Return: -1 if no resource is available, 0 if one was taken
+ */
+int uthread_sem_trydown(uthread_sem_t *sem);
+
+/*
+ * uthread_sem_up - Release a resource
+ * @sem: Semaphore to release a resource to
+ */
+void uthread_sem_up(uthread_sem_t *sem);
+
+/*
+ * uthread_sem_getvalue - Number of resources available
+ * @sem: Semaphore to look at
+ */
+int uthread_sem_getvalue(uthread_sem_t *sem);
+
+/*
+ * uthread_chan_t - Channel type
+ *
+ * A channel carries values of a fixed size from sending threads to receiving
+ * threads, in FIFO order. An unbuffered channel (of capacity 0) makes a sender
+ * and a receiver meet: a value sent to a waiting receiver is copied straight
+ * into the receiver's buffer, which then runs right away. A buffered channel
+ * holds up to its capacity of values, and only blocks senders when it is full
+ * and receivers when it is empty.
+ *
+ * Values are copied from and to buffers of the blocked threads: threads on the
+ * shared stack cannot block on channels. As with the synchronization objects
+ * above, a channel can only be used by the threads of a single scheduler.
+ */
+typedef struct uthread_chan *uthread_chan_t;
+
+/*
+ * uthread_chan_create - Allocate an empty channel
+ * @elemsize: Size of the values (in bytes)
+ * @capacity: Number of values the channel can hold, 0 for an unbuffered
+ *	channel
+ *
+ * Return: Pointer to the new channel, NULL in case of failure
+ */
+uthread_chan_t uthread_chan_create(size_t elemsize, size_t capacity);
+
+/*
+ * uthread_chan_destroy - Deallocate a channel
+ * @chan: Channel to deallocate
+ *
+ * Return: -1 if @chan is NULL or if threads wait on it, 0 otherwise
+ */
+int uthread_chan_destroy(uthread_chan_t chan);
+
+/*
+ * uthread_chan_close - Close a channel
+ * @chan: Channel to close
+ *
+ * Nothing can be sent to a closed channel anymore. Receivers still get the
+ * values it holds, and then fail, as do the threads waiting on it.
+ *
+ * Return: -1 if @chan is NULL or already closed, 0 otherwise
+ */
+int uthread_chan_close(uthread_chan_t chan);
+
+/*
+ * uthread_chan_send - Send a value on a channel
+ * @chan: Channel to send on
+ * @value: Address of the value to send
+ *
+ * The calling thread blocks until a receiver takes the value, or until there
+ * is room for it in @chan.
+ *
+ * Return: -1 if @chan is NULL or closed, or if the calling thread is on the
+ * shared stack and would block, 0 otherwise
+ */
+int uthread_chan_send(uthread_chan_t chan, const void *value);
+
+/*
+ * uthread_chan_recv - Receive a value from a channel
+ * @chan: Channel to receive from
+ * @value: Address receiving the value
+ *
+ * The calling thread blocks until a value is available.
+ *
+ * Return: -1 if @chan is NULL, or closed with no value left, or if the calling
+ * thread is on the shared stack and would block, 0 otherwise
+ */
+int uthread_chan_recv(uthread_chan_t chan, void *value);
+
+/*
+ * uthread_chan_case_t - Operation of uthread_chan_select()
+ * @chan: Channel to operate on
+ * @send: 1 to send on @chan, 0 to receive from it
+ * @value: Address of the value to send, or receiving the value
+ * @closed: Receives 1 if the operation failed because @chan is closed, 0 if it
+ *	was performed
+ */
+typedef struct uthread_chan_case {
+	uthread_chan_t chan;
+	int send;
+	void *value;
+	int closed;
+} uthread_chan_case_t;
+
+/*
+ * uthread_chan_select - Perform one of several channel operations
+ * @cases: Operations to choose from
+ * @ncases: Number of operations in @cases
+ * @block: 1 to wait until an operation can be performed, 0 to return at once
+ *
+ * Exactly one operation is performed, the first one of @cases which can be
+ * when several can, or the first one which becomes possible. An operation on a
+ * closed channel can always be performed, and fails.
+ *
+ * Return: The index in @cases of the operation performed, -1 if none could be
+ * performed without blocking and @block is 0, or if the calling thread is on
+ * the shared stack and would block
+ */
+int uthread_chan_select(uthread_chan_case_t *cases, int ncases, int block);
+
+/*
+ * uthread_pool_t - Thread pool type
+ *
+ * A pool runs short tasks on a fixed set of threads, which it creates once and
+ * for all. Running a task takes no thread creation and no context
+ * initialization: submitting it only queues it, and an idle thread of the pool
+ * picks it up and runs it to completion. Tasks start in the order they were
+ * submitted. A task which blocks keeps its pool thread busy meanwhile, so tasks
+ * waiting for each other can run out of pool threads.
+ *
+ * As with the synchronization objects above, a pool can only be used by the
+ * threads of a single scheduler.
+ */
+typedef struct uthread_pool *uthread_pool_t;
+
+/*
+ * uthread_task_t - Handle of a submitted task
+ */
+typedef struct uthread_task *uthread_task_t;
+
+/*
+ * uthread_pool_create - Create a thread pool
+ * @nthreads: Number of threads of the pool
+ *
+ * Return: Pointer to the new pool, NULL if @nthreads is not positive or in
+ * case of failure
+ */
+uthread_pool_t uthread_pool_create(int nthreads);
+
+/*
+ * uthread_pool_destroy - Destroy a thread pool
+ * @pool: Pool to destroy
+ *
+ * Waits for all the submitted tasks to finish, and for the threads of @pool to
+ * exit. The handles of the tasks which were not waited for become invalid.
+ * Must not be called by a thread of @pool.
+ *
+ * Return: -1 if @pool is NULL, 0 otherwise
+ */
+int uthread_pool_destroy(uthread_pool_t pool);
+
+/*
+ * uthread_pool_submit - Submit a task to a thread pool
+ * @pool: Pool to run the task
+ * @func: Function of the task
+ * @arg: Argument to be passed to @func
+ *
+ * Return: Handle of the task, to be waited for with uthread_task_wait(). NULL
+ * if @pool or @func is NULL, or in case of failure
+ */
+uthread_task_t uthread_pool_submit(uthread_pool_t pool, uthread_func_t func, void *arg);
+
+/*
+ * uthread_task_wait - Wait for a task to finish
+ * @task: Handle of the task
+ * @retval: Address of an integer that will receive the return value
+ *
+ * Waits for @task to finish, assigns the return value of its function to
+ * @retval (if @retval is not NULL), and releases the handle. A task can be
+ * waited for by only one thread, once: tasks nobody waits for are released
+ * with their pool.
+ *
+ * Return: -1 if @task is NULL, 0 otherwise
+ */
+int uthread_task_wait(uthread_task_t task, int *retval);
+
+/*
+ * uthread_future_t - Future type
+ *
+ * A future holds a result which becomes available later, set once by whoever
+ * computes it. Any number of threads can wait for it, and get the result once
+ * it is set. Continuations attached to a future compute the result of another
+ * future from its result: they run in the thread which sets it, right after,
+ * and not in threads of their own.
+ *
+ * As with the synchronization objects above, the threads waiting for a future
+ * must all belong to a single scheduler.
+ */
+typedef struct uthread_future *uthread_future_t;
+
+/*
+ * uthread_future_then_t - Continuation function type
+ * @result: Result of the future the continuation is attached to
+ * @arg: Argument passed to uthread_future_then()
+ *
+ * Return: Result of the future returned by uthread_future_then()
+ */
+typedef void *(*uthread_future_then_t)(void *result, void *arg);
+
+/*
+ * uthread_future_create - Allocate a future
+ *
+ * Return: Pointer to the new future, with no result yet. NULL in case of
+ * failure
+ */
+uthread_future_t uthread_future_create(void);
+
+/*
+ * uthread_future_destroy - Deallocate a future
+ * @future: Future to deallocate
+ *
+ * A future which has no result yet cannot be deallocated while threads wait for
+ * it or continuations are attached to it: the futures of those continuations
+ * would never get a result.
+ *
+ * Return: -1 if @future is NULL, or if threads wait for it or continuations
+ * are attached to it, 0 otherwise
+ */
+int uthread_future_destroy(uthread_future_t future);
+
+/*
+ * uthread_future_set - Set the result of a future
+ * @future: Future to set
+ * @result: Result of @future
+ *
+ * Makes @result available to the threads waiting for @future, which become
+ * ready, and runs the continuations attached to @future in the calling thread,
+ * in the order they were attached, as well as the continuations of the futures
+ * they set in turn.
+ *
+ * Return: -1 if @future is NULL or already has a result, 0 otherwise
+ */
+int uthread_future_set(uthread_future_t future, void *result);
+
+/*
+ * uthread_future_get - Wait for the result of a future
+ * @future: Future to wait for
+ * @result: Address of a pointer that will receive the result
+ *
+ * Blocks the calling thread until @future has a result, and assigns it to
+ * @result (if @result is not NULL).
+ *
+ * Return: -1 if @future is NULL, 0 otherwise
+ */
+int uthread_future_get(uthread_future_t future, void **result);
+
+/*
+ * uthread_future_tryget - Get the result of a future if it is available
+ * @future: Future to get the result of
+ * @result: Address of a pointer that will receive the result
+ *
+ * Return: -1 if @future is NULL or has no result yet, 0 otherwise
+ */
+int uthread_future_tryget(uthread_future_t future, void **result);
+
+/*
+ * uthread_future_then - Attach a continuation to a future
+ * @future: Future to attach the continuation to
+ * @func: Function of the continuation
+ * @arg: Argument to be passed to @func
+ *
+ * Once @future has a result, @func is called with it and @arg, and its return
+ * value becomes the result of the returned future. If @future already has a
+ * result, @func is called right away, by the calling thread. @func runs in
+ * whichever thread sets the result: it should be short, and not block.
+ *
+ * Return: New future, to be deallocated with uthread_future_destroy(). NULL if
+ * @future or @func is NULL, or in case of failure
+ */
+uthread_future_t uthread_future_then(uthread_future_t future, uthread_future_then_t func,
+				     void *arg);
+
 #endif /* _THREAD_H */
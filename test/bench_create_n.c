@@ -0,0 +1,73 @@
+/*
+ * Batch creation benchmark
+ *
+ * Creates batches of threads with uthread_create() in a loop, then with a
+ * single uthread_create_n(), joins them, and reports the cost per thread of
+ * both, creation alone and creation plus join.
+ *
+ * Usage: bench_create_n.x [num_threads] [batch]
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int nop(void *arg)
+{
+    return 0;
+}
+
+static void join_all(uthread_t *tids, int count)
+{
+    for (int i = 0; i < count; ++i)
+        assert(!uthread_join(tids[i], NULL));
+}
+
+int main(int argc, char *argv[])
+{
+    long numThreads = argc > 1 ? atol(argv[1]) : 200000;
+    int batch = argc > 2 ? atoi(argv[2]) : 1000;
+    uthread_t *tids = malloc(batch * sizeof(uthread_t));
+    void **args = calloc(batch, sizeof(void*));
+    double looped = 0, batched = 0, start;
+
+    //warm the stack pool up, both runs reuse its stacks
+    assert(!uthread_stack_pool_config(batch, batch));
+
+    double total = now_sec();
+    for (long i = 0; i < numThreads; i += batch) {
+        start = now_sec();
+        for (int j = 0; j < batch; ++j)
+            tids[j] = uthread_create(nop, args[j]);
+        looped += now_sec() - start;
+        join_all(tids, batch);
+    }
+    double loopedTotal = now_sec() - total;
+
+    total = now_sec();
+    for (long i = 0; i < numThreads; i += batch) {
+        start = now_sec();
+        assert(!uthread_create_n(nop, args, batch, tids));
+        batched += now_sec() - start;
+        join_all(tids, batch);
+    }
+    double batchedTotal = now_sec() - total;
+
+    printf("uthread_create loop: %.1f ns per thread, %.1f ns with join\n",
+           looped * 1e9 / numThreads, loopedTotal * 1e9 / numThreads);
+    printf("uthread_create_n:    %.1f ns per thread, %.1f ns with join (%.1fx)\n",
+           batched * 1e9 / numThreads, batchedTotal * 1e9 / numThreads, looped / batched);
+    free(tids);
+    free(args);
+    return 0;
+}
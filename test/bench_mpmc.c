@@ -0,0 +1,132 @@
+/*
+ * MPMC queue contention benchmark
+ *
+ * P producer pthreads push items as fast as they can to a single consumer
+ * pthread, which is how work gets handed over to the uthread runtime. P goes
+ * from 1 to the number of cores. The lock-free MPMC queue is compared with a
+ * ring queue_t protected by a mutex.
+ *
+ * Usage: bench_mpmc.x [max_producers [items_per_producer]]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mpmc_queue.h>
+#include <queue.h>
+
+#define QUEUE_CAPACITY 4096
+#define DEFAULT_ITEMS 1000000
+
+static long itemsPerProducer = DEFAULT_ITEMS;
+
+/*
+ * both queues behind the same interface
+ */
+struct bench_queue {
+    int (*enqueue)(struct bench_queue *q, void *data);
+    int (*dequeue)(struct bench_queue *q, void **data);
+    mpmc_queue_t mpmc;
+    queue_t locked;
+    pthread_mutex_t lock;
+};
+
+static int mpmc_enqueue(struct bench_queue *q, void *data)
+{
+    return mpmc_queue_enqueue(q->mpmc, data);
+}
+
+static int mpmc_dequeue(struct bench_queue *q, void **data)
+{
+    return mpmc_queue_dequeue(q->mpmc, data);
+}
+
+static int locked_enqueue(struct bench_queue *q, void *data)
+{
+    int ret = -1;
+    pthread_mutex_lock(&q->lock);
+    //same bound as the MPMC queue
+    if(queue_length(q->locked) < QUEUE_CAPACITY)
+        ret = queue_enqueue(q->locked, data);
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+static int locked_dequeue(struct bench_queue *q, void **data)
+{
+    pthread_mutex_lock(&q->lock);
+    int ret = queue_dequeue(q->locked, data);
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+static void *producer(void *arg)
+{
+    struct bench_queue *q = arg;
+    for (uintptr_t i = 1; i <= itemsPerProducer; ++i)
+        while(q->enqueue(q, (void*)i))
+            sched_yield();
+    return NULL;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * run @numProducers producers, consume everything from
+ * the calling thread and return the throughput in Mops/s
+ */
+static double run(struct bench_queue *q, int numProducers)
+{
+    pthread_t *producers = malloc(numProducers * sizeof(pthread_t));
+    long total = numProducers * itemsPerProducer;
+    void *item;
+
+    double start = now_ns();
+    for (int i = 0; i < numProducers; ++i)
+        pthread_create(&producers[i], NULL, producer, q);
+    for (long received = 0; received < total;) {
+        if(q->dequeue(q, &item))
+            sched_yield();
+        else
+            ++received;
+    }
+    double elapsed = now_ns() - start;
+
+    for (int i = 0; i < numProducers; ++i)
+        pthread_join(producers[i], NULL);
+    free(producers);
+    return total / elapsed * 1e3;
+}
+
+int main(int argc, char **argv)
+{
+    int maxProducers = sysconf(_SC_NPROCESSORS_ONLN);
+    if(argc > 1)
+        maxProducers = atoi(argv[1]);
+    if(argc > 2)
+        itemsPerProducer = atol(argv[2]);
+
+    struct bench_queue mpmc = {mpmc_enqueue, mpmc_dequeue};
+    struct bench_queue locked = {locked_enqueue, locked_dequeue};
+    mpmc.mpmc = mpmc_queue_create(QUEUE_CAPACITY);
+    locked.locked = queue_create_type(QUEUE_RING);
+    pthread_mutex_init(&locked.lock, NULL);
+
+    printf("%10s %14s %14s\n", "producers", "mpmc Mops/s", "mutex Mops/s");
+    for (int p = 1; p <= maxProducers; ++p)
+        printf("%10d %14.2f %14.2f\n", p, run(&mpmc, p), run(&locked, p));
+
+    mpmc_queue_destroy(mpmc.mpmc);
+    queue_destroy(locked.locked);
+    return 0;
+}
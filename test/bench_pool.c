@@ -0,0 +1,68 @@
+/*
+ * Thread pool benchmark
+ *
+ * Runs batches of tiny tasks, first as threads of their own created and
+ * joined one batch at a time, then submitted to a pool and waited for, and
+ * reports the cost per task of both.
+ *
+ * Usage: bench_pool.x [num_tasks]
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define BATCH 64
+#define POOL_THREADS 8
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int tiny(void *arg)
+{
+    return (int)(long)arg + 1;
+}
+
+int main(int argc, char *argv[])
+{
+    long numTasks = argc > 1 ? atol(argv[1]) : 1000000;
+    uthread_t tids[BATCH];
+    uthread_task_t tasks[BATCH];
+    int retval;
+
+    double start = now_sec();
+    for (long i = 0; i < numTasks; i += BATCH) {
+        for (int j = 0; j < BATCH; ++j)
+            tids[j] = uthread_create(tiny, (void*)(long)j);
+        for (int j = 0; j < BATCH; ++j) {
+            assert(!uthread_join(tids[j], &retval));
+            assert(retval == j + 1);
+        }
+    }
+    double threads = now_sec() - start;
+
+    uthread_pool_t pool = uthread_pool_create(POOL_THREADS);
+    start = now_sec();
+    for (long i = 0; i < numTasks; i += BATCH) {
+        for (int j = 0; j < BATCH; ++j)
+            tasks[j] = uthread_pool_submit(pool, tiny, (void*)(long)j);
+        for (int j = 0; j < BATCH; ++j) {
+            assert(!uthread_task_wait(tasks[j], &retval));
+            assert(retval == j + 1);
+        }
+    }
+    double pooled = now_sec() - start;
+    uthread_pool_destroy(pool);
+
+    printf("create and join: %.1f ns per task\n", threads * 1e9 / numTasks);
+    printf("submit and wait: %.1f ns per task (%.1fx)\n",
+           pooled * 1e9 / numTasks, threads / pooled);
+    return 0;
+}
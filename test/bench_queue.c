@@ -0,0 +1,288 @@
+/*
+ * Queue micro-benchmark
+ *
+ * Measures the cost of every queue.h operation on a queue holding N items,
+ * for N from 10 to 1M, and reports the mean, median and 99th percentile time
+ * per call, as well as the number of heap allocations per call. Every backend
+ * of queue_type_t runs through the exact same harness.
+ *
+ * Each operation is timed over many samples. A sample times a small run of
+ * calls and then puts the queue back into its original state, untimed, so
+ * that the queue always holds the same N items.
+ *
+ * Usage: bench_queue.x [max_size]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <queue.h>
+
+#define MIN_SIZE 10
+#define MAX_SIZE 1000000
+#define BATCH 64
+#define MAX_SAMPLES 1000
+#define MIN_SAMPLES 50
+//bound on the number of items touched by O(n) operations, per size
+#define SCAN_BUDGET 20000000
+
+/*
+ * Count heap allocations by interposing the allocator
+ * of the C library for the whole program
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocations;
+
+void *malloc(size_t size)
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    ++allocations;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    ++allocations;
+    return __libc_realloc(ptr, size);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Items are addresses in this array, so that they are
+ * all distinct and can be looked up by queue_delete()
+ */
+static char *items;
+static void *batch[BATCH];
+
+/*
+ * state of the benchmark of one operation
+ */
+struct bench {
+    queue_t queue;
+    int size;
+    int calls;             // number of calls timed per sample
+    double *samples;       // ns per call of each sample
+    int numSamples;
+    unsigned long allocs;  // allocations done in timed regions
+};
+
+typedef void (*bench_func_t)(struct bench *b);
+
+static int count_item(void *data, void *arg)
+{
+    ++*(int*)arg;
+    return 0;
+}
+
+static void bench_enqueue(struct bench *b)
+{
+    queue_dequeue_batch(b->queue, batch, b->calls);
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < b->calls; ++i)
+        queue_enqueue(b->queue, batch[i]);
+    b->samples[b->numSamples] = (now_ns() - start) / b->calls;
+    b->allocs += allocations - allocs;
+}
+
+static void bench_dequeue(struct bench *b)
+{
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < b->calls; ++i)
+        queue_dequeue(b->queue, &batch[i]);
+    b->samples[b->numSamples] = (now_ns() - start) / b->calls;
+    b->allocs += allocations - allocs;
+    queue_enqueue_batch(b->queue, batch, b->calls);
+}
+
+static void bench_enqueue_batch(struct bench *b)
+{
+    queue_dequeue_batch(b->queue, batch, b->calls);
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    queue_enqueue_batch(b->queue, batch, b->calls);
+    b->samples[b->numSamples] = now_ns() - start;
+    b->allocs += allocations - allocs;
+}
+
+static void bench_dequeue_batch(struct bench *b)
+{
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    queue_dequeue_batch(b->queue, batch, b->calls);
+    b->samples[b->numSamples] = now_ns() - start;
+    b->allocs += allocations - allocs;
+    queue_enqueue_batch(b->queue, batch, b->calls);
+}
+
+static void bench_delete(struct bench *b)
+{
+    //any item, the queue always holds all of them
+    void *item = &items[rand() % b->size];
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    queue_delete(b->queue, item);
+    b->samples[b->numSamples] = now_ns() - start;
+    b->allocs += allocations - allocs;
+    queue_enqueue(b->queue, item);
+}
+
+static void bench_iterate(struct bench *b)
+{
+    int count = 0;
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    queue_iterate(b->queue, count_item, &count, NULL);
+    b->samples[b->numSamples] = now_ns() - start;
+    b->allocs += allocations - allocs;
+}
+
+static void bench_length(struct bench *b)
+{
+    volatile int length;
+    unsigned long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < b->calls; ++i)
+        length = queue_length(b->queue);
+    b->samples[b->numSamples] = (now_ns() - start) / b->calls;
+    b->allocs += allocations - allocs;
+    (void)length;
+}
+
+/*
+ * operations, @batched ones are timed per call over a batch
+ * of items, @linear ones cost O(size) and get fewer samples
+ */
+static const struct operation {
+    const char *name;
+    bench_func_t func;
+    int batched;
+    int linear;
+} operations[] = {
+    {"enqueue",       bench_enqueue,       0, 0},
+    {"dequeue",       bench_dequeue,       0, 0},
+    {"enqueue_batch", bench_enqueue_batch, 1, 0},
+    {"dequeue_batch", bench_dequeue_batch, 1, 0},
+    {"delete",        bench_delete,        0, 1},
+    {"iterate",       bench_iterate,       0, 1},
+    {"length",        bench_length,        0, 0},
+};
+
+static const struct backend {
+    const char *name;
+    queue_type_t type;
+} backends[] = {
+    {"list", QUEUE_LIST},
+    {"ring", QUEUE_RING},
+};
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *backend, const char *op, int size,
+                   struct bench *b, int callsPerSample)
+{
+    double sum = 0;
+    for (int i = 0; i < b->numSamples; ++i)
+        sum += b->samples[i];
+    qsort(b->samples, b->numSamples, sizeof(double), compare_double);
+
+    printf("%-6s %-14s %8d %12.1f %12.1f %12.1f %10.2f\n", backend, op, size,
+           sum / b->numSamples,
+           b->samples[b->numSamples / 2],
+           b->samples[(int)(b->numSamples * 0.99)],
+           (double)b->allocs / ((double)b->numSamples * callsPerSample));
+}
+
+/*
+ * creating and destroying an empty queue does not depend on the size
+ */
+static void bench_create(const struct backend *backend, double *samples)
+{
+    struct bench b = {.samples = samples, .size = 0};
+    for (; b.numSamples < MAX_SAMPLES; ++b.numSamples) {
+        unsigned long allocs = allocations;
+        double start = now_ns();
+        queue_destroy(queue_create_type(backend->type));
+        b.samples[b.numSamples] = now_ns() - start;
+        b.allocs += allocations - allocs;
+    }
+    report(backend->name, "create+destroy", 0, &b, 1);
+}
+
+static void bench_size(const struct backend *backend, int size,
+                       double *samples)
+{
+    queue_t queue = queue_create_type(backend->type);
+    for (int i = 0; i < size; ++i)
+        queue_enqueue(queue, &items[i]);
+
+    for (int op = 0; op < sizeof(operations) / sizeof(operations[0]); ++op) {
+        struct bench b = {
+            .queue = queue,
+            .size = size,
+            .calls = size < BATCH ? size : BATCH,
+            .samples = samples,
+        };
+        int numSamples = MAX_SAMPLES;
+        if(operations[op].linear && SCAN_BUDGET / size < numSamples)
+            numSamples = SCAN_BUDGET / size < MIN_SAMPLES ?
+                MIN_SAMPLES : SCAN_BUDGET / size;
+
+        for (; b.numSamples < numSamples; ++b.numSamples)
+            operations[op].func(&b);
+        //allocations are counted per call, batched calls included
+        report(backend->name, operations[op].name, size, &b,
+               operations[op].linear || operations[op].batched ? 1 : b.calls);
+    }
+
+    while(queue_dequeue_batch(queue, batch, BATCH) > 0)
+        ;
+    queue_destroy(queue);
+}
+
+int main(int argc, char **argv)
+{
+    int maxSize = MAX_SIZE;
+    if(argc > 1)
+        maxSize = atoi(argv[1]);
+    if(maxSize < MIN_SIZE)
+        maxSize = MIN_SIZE;
+
+    items = malloc(maxSize);
+    double *samples = malloc(MAX_SAMPLES * sizeof(double));
+
+    printf("batched operations move %d items per call (fewer when size < %d)\n",
+           BATCH, BATCH);
+    printf("%-6s %-14s %8s %12s %12s %12s %10s\n", "queue", "operation",
+           "size", "mean ns/op", "p50 ns/op", "p99 ns/op", "allocs/op");
+    for (int i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        bench_create(&backends[i], samples);
+        for (int size = MIN_SIZE; size <= maxSize; size *= 10)
+            bench_size(&backends[i], size, samples);
+    }
+
+    free(samples);
+    free(items);
+    return 0;
+}
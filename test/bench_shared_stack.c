@@ -0,0 +1,112 @@
+/*
+ * Shared stack vs dedicated stack benchmark
+ *
+ * Parks a large number of threads, each of them a few KiB deep in its stack,
+ * and reports the resident memory cost per parked thread and the cost of a
+ * context switch when cycling through all of them. Each mode runs in its own
+ * process so that RSS numbers do not interfere.
+ *
+ * Usage: bench_shared_stack.x [num_threads [stack_depth_bytes]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define DEFAULT_THREADS 20000
+#define DEFAULT_DEPTH 2048
+#define ROUNDS 20
+
+static int numThreads = DEFAULT_THREADS;
+static size_t stackDepth = DEFAULT_DEPTH;
+static volatile int stop = 0;
+
+static long resident_pages(void)
+{
+    long size, resident;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if(!statm || fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        resident = -1;
+    if(statm)
+        fclose(statm);
+    return resident;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * dig @stackDepth bytes into the stack, then park
+ */
+static int parked_thread(void *arg)
+{
+    volatile char *frame = __builtin_alloca(stackDepth);
+    memset((char*)frame, 1, stackDepth);
+
+    while(!stop)
+        uthread_yield();
+    return frame[0];
+}
+
+static void run(const char *name, int shared)
+{
+    uthread_attr_t attr;
+    uthread_attr_init(&attr);
+    if(uthread_attr_setsharedstack(&attr, shared)){
+        printf("%-10s not supported by this build\n", name);
+        return;
+    }
+
+    uthread_t *tids = malloc(numThreads * sizeof(uthread_t));
+    long before = resident_pages();
+    for (int i = 0; i < numThreads; ++i)
+        tids[i] = uthread_create_attr(parked_thread, NULL, &attr);
+
+    //let every thread run once and park
+    uthread_yield();
+    long after = resident_pages();
+
+    double start = now_ns();
+    for (int i = 0; i < ROUNDS; ++i)
+        uthread_yield();
+    double elapsed = now_ns() - start;
+
+    stop = 1;
+    for (int i = 0; i < numThreads; ++i)
+        uthread_join(tids[i], NULL);
+    free(tids);
+
+    printf("%-10s %8d threads  %8.0f bytes/thread  %8.1f ns/switch\n",
+           name, numThreads,
+           (double)(after - before) * sysconf(_SC_PAGESIZE) / numThreads,
+           elapsed / ((double)ROUNDS * (numThreads + 1)));
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1)
+        numThreads = atoi(argv[1]);
+    if(argc > 2)
+        stackDepth = atol(argv[2]);
+
+    const char *names[] = {"dedicated", "shared"};
+    for (int shared = 0; shared < 2; ++shared) {
+        pid_t pid = fork();
+        if(pid == 0){
+            run(names[shared], shared);
+            exit(EXIT_SUCCESS);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
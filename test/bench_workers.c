@@ -0,0 +1,116 @@
+/*
+ * M:N scheduling benchmark
+ *
+ * Runs a CPU-bound task graph, a tree of threads each computing a bit and
+ * joining its two children, with 1 worker and then up to one worker per CPU,
+ * and reports the run time and the speedup over a single worker. The number
+ * of workers can only be set once per process, so each run is made by a
+ * child process.
+ *
+ * With little work per thread, the run time is mostly spent creating, joining
+ * and switching threads, all under the lock of the scheduler: this is the case
+ * where more workers help the least.
+ *
+ * Usage: bench_workers.x [max_workers] [work]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define DEPTH 12
+#define DEFAULT_WORK 100000
+
+static int work = DEFAULT_WORK;
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * a node of the task graph, its argument is its depth
+ */
+int task(void *arg)
+{
+    long depth = (long)arg;
+    unsigned int x = depth;
+    for (int i = 0; i < work; ++i)
+        x = x * 1103515245 + 12345;
+    if(depth == 0)
+        return x & 1;
+
+    int left, right;
+    uthread_t l = uthread_create(task, (void*)(depth - 1));
+    uthread_t r = uthread_create(task, (void*)(depth - 1));
+    uthread_join(l, &left);
+    uthread_join(r, &right);
+    return (x & 1) + left + right;
+}
+
+/*
+ * run the task graph with @workers workers, in a child
+ * process, and return its run time in seconds
+ */
+static double run(int workers)
+{
+    int pipefd[2];
+    double elapsed = -1;
+
+    if(pipe(pipefd) < 0)
+        return -1;
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        uthread_workers_config(workers);
+        double start = now_sec();
+        int result;
+        uthread_join(uthread_create(task, (void*)DEPTH), &result);
+        elapsed = now_sec() - start;
+        if(write(pipefd[1], &elapsed, sizeof(elapsed)) < 0)
+            exit(EXIT_FAILURE);
+        exit(EXIT_SUCCESS);
+    }
+    close(pipefd[1]);
+    if(pid < 0 || read(pipefd[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+        elapsed = -1;
+    close(pipefd[0]);
+    waitpid(pid, NULL, 0);
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    int maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if(argc > 1)
+        maxWorkers = atoi(argv[1]);
+    if(maxWorkers < 1)
+        maxWorkers = 1;
+    if(argc > 2)
+        work = atoi(argv[2]);
+
+    printf("task graph of %d threads, %d iterations each, %d online CPUs\n",
+           (2 << DEPTH) - 1, work, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %12s %10s\n", "workers", "time (ms)", "speedup");
+    double base = 0;
+    for (int workers = 1; workers <= maxWorkers; workers *= 2) {
+        double elapsed = run(workers);
+        if(elapsed < 0){
+            printf("%8d %12s\n", workers, "failed");
+            continue;
+        }
+        if(workers == 1)
+            base = elapsed;
+        printf("%8d %12.1f %10.2f\n", workers, elapsed * 1e3, base / elapsed);
+        //always include the largest count
+        if(workers < maxWorkers && workers * 2 > maxWorkers)
+            workers = maxWorkers / 2;
+    }
+    return 0;
+}
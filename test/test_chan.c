@@ -0,0 +1,326 @@
+/*
+ * Channel test
+ *
+ * Values go through unbuffered and buffered channels in order, a value sent on
+ * an unbuffered channel has been received by the time the send returns, and a
+ * receiver already waiting runs right away, closing a channel wakes everybody
+ * up, select picks the operation which can be performed, and a pipeline works
+ * with one or several workers.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <uthread.h>
+
+#define NUM_VALUES 10000
+
+static uthread_chan_t chan;
+static long delivered;
+static volatile long received;
+
+int producer(void *arg)
+{
+    for (long i = 0; i < NUM_VALUES; ++i)
+        assert(!uthread_chan_send(chan, &i));
+    return 0;
+}
+
+int consumer(void *arg)
+{
+    for (long i = 0; i < NUM_VALUES; ++i) {
+        long value;
+        assert(!uthread_chan_recv(chan, &value));
+        assert(value == i);
+    }
+    return 0;
+}
+
+int receive_in_place(void *arg)
+{
+    //the value lands where the sender can check it
+    for (long i = 0; i < NUM_VALUES; ++i)
+        assert(!uthread_chan_recv(chan, &delivered));
+    return 0;
+}
+
+int waiting_receiver(void *arg)
+{
+    for (long i = 0; i < NUM_VALUES; ++i) {
+        long value;
+        assert(!uthread_chan_recv(chan, &value));
+        received = value;
+    }
+    return 0;
+}
+
+void test_order(size_t capacity)
+{
+    chan = uthread_chan_create(sizeof(long), capacity);
+    assert(chan);
+    uthread_t consumerTid = uthread_create(consumer, NULL);
+    uthread_t producerTid = uthread_create(producer, NULL);
+    assert(!uthread_join(producerTid, NULL));
+    assert(!uthread_join(consumerTid, NULL));
+    assert(!uthread_chan_destroy(chan));
+}
+
+void test_unbuffered(void)
+{
+    test_order(0);
+
+    //the receiver has the value before we go on, whether
+    //it was already waiting or not
+    chan = uthread_chan_create(sizeof(long), 0);
+    delivered = -1;
+    uthread_t tid = uthread_create(receive_in_place, NULL);
+    for (long i = 0; i < NUM_VALUES; ++i) {
+        assert(!uthread_chan_send(chan, &i));
+        assert(delivered == i);
+    }
+    assert(!uthread_join(tid, NULL));
+    assert(!uthread_chan_destroy(chan));
+
+    //a receiver already waiting runs before we go on: ticks
+    //must not take the CPU back before it can tell us
+    assert(!uthread_preempt_config(0, UTHREAD_PREEMPT_CPU));
+    chan = uthread_chan_create(sizeof(long), 0);
+    received = -1;
+    tid = uthread_create(waiting_receiver, NULL);
+    //it waits for each value by the time we send it
+    uthread_yield();
+    for (long i = 0; i < NUM_VALUES; ++i) {
+        assert(!uthread_chan_send(chan, &i));
+        assert(received == i);
+    }
+    assert(!uthread_join(tid, NULL));
+    assert(!uthread_chan_destroy(chan));
+    //back to the defaults
+    assert(!uthread_preempt_config(100, UTHREAD_PREEMPT_CPU));
+    printf("Unbuffered channel test: success.\n");
+}
+
+void test_buffered(void)
+{
+    test_order(4);
+
+    //sending only blocks once the channel is full
+    chan = uthread_chan_create(sizeof(long), 4);
+    for (long i = 0; i < 4; ++i)
+        assert(!uthread_chan_send(chan, &i));
+    uthread_t tid = uthread_create(producer, NULL);
+    uthread_yield();
+    for (long i = 0; i < 4; ++i) {
+        long value;
+        assert(!uthread_chan_recv(chan, &value));
+        assert(value == i);
+    }
+    for (long i = 0; i < NUM_VALUES; ++i) {
+        long value;
+        assert(!uthread_chan_recv(chan, &value));
+        assert(value == i);
+    }
+    assert(!uthread_join(tid, NULL));
+    assert(!uthread_chan_destroy(chan));
+    printf("Buffered channel test: success.\n");
+}
+
+int closed_receiver(void *arg)
+{
+    long value;
+    return uthread_chan_recv(arg, &value);
+}
+
+void test_close(void)
+{
+    long value = 42;
+    int retval;
+
+    //a waiting receiver fails
+    chan = uthread_chan_create(sizeof(long), 0);
+    uthread_t tid = uthread_create(closed_receiver, chan);
+    uthread_yield();
+    assert(uthread_chan_destroy(chan) == -1);
+    assert(!uthread_chan_close(chan));
+    assert(uthread_chan_close(chan) == -1);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == -1);
+    assert(uthread_chan_send(chan, &value) == -1);
+    assert(!uthread_chan_destroy(chan));
+
+    //values sent before closing are still received
+    chan = uthread_chan_create(sizeof(long), 2);
+    assert(!uthread_chan_send(chan, &value));
+    assert(!uthread_chan_close(chan));
+    value = 0;
+    assert(!uthread_chan_recv(chan, &value));
+    assert(value == 42);
+    assert(uthread_chan_recv(chan, &value) == -1);
+    assert(!uthread_chan_destroy(chan));
+    printf("Close test: success.\n");
+}
+
+static uthread_chan_t chans[2];
+
+int sender(void *arg)
+{
+    long index = (long)arg;
+    assert(!uthread_chan_send(chans[index], &index));
+    return 0;
+}
+
+void test_select(void)
+{
+    long values[2] = {-1, -1};
+    uthread_chan_case_t cases[2] = {
+        {.send = 0, .value = &values[0]},
+        {.send = 0, .value = &values[1]},
+    };
+
+    for (int i = 0; i < 2; ++i) {
+        chans[i] = uthread_chan_create(sizeof(long), 1);
+        cases[i].chan = chans[i];
+    }
+    assert(uthread_chan_select(cases, 2, 0) == -1);
+
+    //the first case which can be performed
+    long one = 1;
+    assert(!uthread_chan_send(chans[1], &one));
+    assert(uthread_chan_select(cases, 2, 0) == 1);
+    assert(values[1] == 1 && !cases[1].closed);
+
+    //or the first one which becomes possible, the other one
+    //is no longer waited for
+    for (int round = 0; round < 100; ++round) {
+        long index = round % 2;
+        values[index] = -1;
+        uthread_t tid = uthread_create(sender, (void*)index);
+        assert(uthread_chan_select(cases, 2, 1) == index);
+        assert(values[index] == index);
+        assert(!uthread_join(tid, NULL));
+    }
+
+    //a send case, and a closed channel
+    long two = 2, value;
+    uthread_chan_case_t send = {.chan = chans[0], .send = 1, .value = &two};
+    assert(uthread_chan_select(&send, 1, 0) == 0);
+    assert(!uthread_chan_recv(chans[0], &value));
+    assert(value == 2);
+    assert(!uthread_chan_close(chans[1]));
+    assert(uthread_chan_select(cases, 2, 1) == 1);
+    assert(cases[1].closed);
+
+    for (int i = 0; i < 2; ++i)
+        assert(!uthread_chan_destroy(chans[i]));
+    printf("Select test: success.\n");
+}
+
+#define NUM_STAGES 4
+
+static uthread_chan_t stages[NUM_STAGES + 1];
+
+/*
+ * add one to every value, until the channel is closed
+ */
+int stage(void *arg)
+{
+    long index = (long)arg;
+    long value;
+
+    while(!uthread_chan_recv(stages[index], &value)){
+        value++;
+        assert(!uthread_chan_send(stages[index + 1], &value));
+    }
+    assert(!uthread_chan_close(stages[index + 1]));
+    return 0;
+}
+
+void pipeline_main(void)
+{
+    uthread_t tids[NUM_STAGES];
+    long sum = 0, next = 0, value;
+
+    for (int i = 0; i <= NUM_STAGES; ++i)
+        stages[i] = uthread_chan_create(sizeof(long), i % 2 ? 8 : 0);
+    for (long i = 0; i < NUM_STAGES; ++i)
+        tids[i] = uthread_create(stage, (void*)i);
+    chan = stages[0];
+    uthread_t tid = uthread_create(producer, NULL);
+    for (long i = 0; i < NUM_VALUES; ++i)
+        sum -= i;
+
+    //feed the first stage while receiving from the last one
+    uthread_chan_case_t cases[2] = {
+        {.chan = stages[NUM_STAGES], .send = 0, .value = &value},
+        {.chan = stages[0], .send = 1, .value = &next},
+    };
+    for (long left = NUM_VALUES + NUM_VALUES / 10; left; ) {
+        int ncases = next < NUM_VALUES / 10 ? 2 : 1;
+        if(uthread_chan_select(cases, ncases, 1) == 0){
+            sum += value - NUM_STAGES;
+            left--;
+        }else{
+            sum -= next++;
+        }
+    }
+    assert(sum == 0);
+
+    assert(!uthread_join(tid, NULL));
+    assert(!uthread_chan_close(stages[0]));
+    assert(uthread_chan_recv(stages[NUM_STAGES], &value) == -1);
+    for (int i = 0; i < NUM_STAGES; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    for (int i = 0; i <= NUM_STAGES; ++i)
+        assert(!uthread_chan_destroy(stages[i]));
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    pipeline_main();
+    return NULL;
+}
+
+void test_pipeline(void)
+{
+    pthread_t pthread;
+
+    pipeline_main();
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Pipeline test: success.\n");
+}
+
+int shared_receiver(void *arg)
+{
+    long value;
+    return uthread_chan_recv(arg, &value);
+}
+
+void test_shared_stack(void)
+{
+    uthread_attr_t attr;
+    int retval;
+
+    uthread_attr_init(&attr);
+    if(uthread_attr_setsharedstack(&attr, 1))
+        return;
+    chan = uthread_chan_create(sizeof(long), 0);
+    uthread_t tid = uthread_create_attr(shared_receiver, chan, &attr);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == -1);
+    assert(!uthread_chan_destroy(chan));
+    printf("Shared stack test: success.\n");
+}
+
+int main(void)
+{
+    test_unbuffered();
+    test_buffered();
+    test_close();
+    test_select();
+    test_pipeline();
+    test_shared_stack();
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Batch creation test
+ *
+ * Threads created at once each get their own argument and TID, run in the
+ * order of their arguments, can be joined or waited for like any other
+ * thread, and also get created with several workers.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <uthread.h>
+
+#define NUM_THREADS 1000
+
+static int order[NUM_THREADS];
+static int numRan;
+
+int record(void *arg)
+{
+    order[numRan++] = (long)arg;
+    return (long)arg + 1;
+}
+
+void test_create_n(void)
+{
+    static void *args[NUM_THREADS];
+    static uthread_t tids[NUM_THREADS];
+    int retval;
+
+    assert(uthread_create_n(NULL, args, 1, tids) == -1);
+    assert(uthread_create_n(record, args, -1, tids) == -1);
+    assert(!uthread_create_n(record, args, 0, tids));
+
+    for (long i = 0; i < NUM_THREADS; ++i)
+        args[i] = (void*)i;
+    assert(!uthread_create_n(record, args, NUM_THREADS, tids));
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        for (int j = 0; j < i; ++j)
+            assert(tids[j] != tids[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        assert(!uthread_join(tids[i], &retval));
+        assert(retval == i + 1);
+    }
+    assert(numRan == NUM_THREADS);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(order[i] == i);
+    printf("Batch creation test: success.\n");
+}
+
+static int numNull;
+
+int count_null(void *arg)
+{
+    if(!arg)
+        __atomic_add_fetch(&numNull, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void create_n_main(void)
+{
+    static uthread_t tids[NUM_THREADS];
+
+    numNull = 0;
+    //no arguments, no TIDs wanted for the second batch
+    assert(!uthread_create_n(count_null, NULL, NUM_THREADS, tids));
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(!uthread_create_n(count_null, NULL, NUM_THREADS, NULL));
+    while(__atomic_load_n(&numNull, __ATOMIC_RELAXED) < 2 * NUM_THREADS)
+        uthread_yield();
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    create_n_main();
+    return NULL;
+}
+
+void test_workers(void)
+{
+    pthread_t pthread;
+
+    create_n_main();
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Batch creation with workers test: success.\n");
+}
+
+int main(void)
+{
+    test_create_n();
+    test_workers();
+    return 0;
+}
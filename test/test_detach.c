@@ -0,0 +1,160 @@
+/*
+ * Detach test
+ *
+ * - detached threads cannot be joined, and are freed as soon as they finish,
+ *   so creating lots of them without ever joining keeps memory bounded
+ * - a finished thread is freed when it gets detached, and threads can
+ *   detach themselves
+ * - a thread being joined cannot be detached
+ * - detached threads also go away with several workers
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <uthread.h>
+
+#define NUM_CREATIONS 200000
+#define NUM_WORKER_CREATIONS 20000
+#define MAX_GROWTH_KB (16 * 1024)
+
+static atomic_int finished;
+
+int touch_stack(void *arg)
+{
+    //dirty some of the stack, so that leaked stacks would use memory
+    char buffer[4096];
+    memset(buffer, 1, sizeof(buffer));
+    atomic_fetch_add(&finished, 1);
+    return buffer[sizeof(buffer) - 1];
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/*
+ * create detached threads, and wait for all of them to finish
+ */
+void create_detached(int count)
+{
+    uthread_attr_t attr;
+
+    uthread_attr_init(&attr);
+    assert(!uthread_attr_setdetached(&attr, 1));
+    atomic_store(&finished, 0);
+    for (int i = 0; i < count; ++i) {
+        int tid = uthread_create_attr(touch_stack, NULL, &attr);
+        assert(tid > 0);
+        if(i % 64 == 0)
+            uthread_yield();
+    }
+    while(atomic_load(&finished) < count)
+        uthread_yield();
+}
+
+void test_fire_and_forget(void)
+{
+    //warm up, so that only leaks make us grow
+    create_detached(1000);
+    long before = max_rss_kb();
+    create_detached(NUM_CREATIONS);
+    assert(max_rss_kb() - before < MAX_GROWTH_KB);
+    printf("Fire and forget test: success.\n");
+}
+
+int return_arg(void *arg)
+{
+    return (int)(long)arg;
+}
+
+int detach_self(void *arg)
+{
+    assert(!uthread_detach(uthread_self()));
+    uthread_yield();
+    return 0;
+}
+
+void test_detach(void)
+{
+    //a running thread
+    int tid = uthread_create(return_arg, NULL);
+    assert(!uthread_detach(tid));
+    assert(uthread_detach(tid) == -1);
+    assert(uthread_join(tid, NULL) == -1);
+    uthread_yield();
+
+    //a finished one, which is gone right away
+    tid = uthread_create(return_arg, NULL);
+    uthread_yield();
+    assert(!uthread_detach(tid));
+    assert(uthread_join(tid, NULL) == -1);
+    assert(uthread_detach(tid) == -1);
+
+    //ourselves
+    tid = uthread_create(detach_self, NULL);
+    uthread_yield();
+    assert(uthread_join(tid, NULL) == -1);
+    uthread_yield();
+
+    assert(uthread_detach(0) == -1);
+    printf("Detach test: success.\n");
+}
+
+int joiner(void *arg)
+{
+    int retval = -1;
+    assert(!uthread_join((uthread_t)(long)arg, &retval));
+    return retval;
+}
+
+int yielder(void *arg)
+{
+    uthread_yield();
+    return 42;
+}
+
+void test_joined(void)
+{
+    int retval = -1;
+
+    int tid = uthread_create(yielder, NULL);
+    int joinerTid = uthread_create(joiner, (void*)(long)tid);
+    uthread_yield();
+    //the joiner waits for it
+    assert(uthread_detach(tid) == -1);
+    assert(!uthread_join(joinerTid, &retval));
+    assert(retval == 42);
+    printf("Joined thread test: success.\n");
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    create_detached(NUM_WORKER_CREATIONS);
+    return NULL;
+}
+
+void test_workers(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Detached threads with workers test: success.\n");
+}
+
+int main(void)
+{
+    test_fire_and_forget();
+    test_detach();
+    test_joined();
+    test_workers();
+    return 0;
+}
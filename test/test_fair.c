@@ -0,0 +1,73 @@
+/*
+ * Fair-share scheduling test
+ *
+ * With the fair policy, always-ready threads get CPU time in proportion to
+ * their weights.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define SPIN_MS 400
+
+static volatile int stop;
+static volatile unsigned long counters[2];
+
+int spinner(void *arg)
+{
+    volatile unsigned long *counter = arg;
+    while(!stop)
+        ++*counter;
+    return 0;
+}
+
+/*
+ * let two spinners of weights @weight0 and @weight1 share
+ * the CPU for a while
+ * Return value:
+ * the ratio of the work they did
+ */
+double share(unsigned int weight0, unsigned int weight1)
+{
+    stop = 0;
+    counters[0] = counters[1] = 0;
+    uthread_t tids[2] = {
+        uthread_create(spinner, (void*)&counters[0]),
+        uthread_create(spinner, (void*)&counters[1]),
+    };
+    assert(!uthread_setweight(tids[0], weight0));
+    assert(!uthread_setweight(tids[1], weight1));
+    assert(uthread_getweight(tids[1]) == weight1);
+
+    //we get a fair share too, as long as we keep spinning
+    clock_t end = clock() + SPIN_MS * CLOCKS_PER_SEC / 1000;
+    while(clock() < end)
+        ;
+    stop = 1;
+    assert(!uthread_join(tids[0], NULL));
+    assert(!uthread_join(tids[1], NULL));
+    return (double)counters[1] / counters[0];
+}
+
+int main()
+{
+    assert(uthread_sched_config(42) == -1);
+    assert(!uthread_sched_config(UTHREAD_SCHED_FAIR));
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_CPU));
+
+    assert(uthread_getweight(0) == UTHREAD_WEIGHT_DEFAULT);
+    assert(uthread_sched_config(UTHREAD_SCHED_FIFO) == -1);
+    assert(uthread_setweight(0, 0) == -1);
+    assert(uthread_setweight(0, UTHREAD_WEIGHT_MAX + 1) == -1);
+    assert(uthread_setweight(12345, UTHREAD_WEIGHT_DEFAULT) == -1);
+
+    double even = share(UTHREAD_WEIGHT_DEFAULT, UTHREAD_WEIGHT_DEFAULT);
+    assert(even > 0.75 && even < 1.33);
+    double triple = share(UTHREAD_WEIGHT_DEFAULT, 3 * UTHREAD_WEIGHT_DEFAULT);
+    assert(triple > 1.8 && triple < 5);
+    printf("Fair-share test: success.\n");
+    return 0;
+}
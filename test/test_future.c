@@ -0,0 +1,201 @@
+/*
+ * Future test
+ *
+ * All the threads waiting for a future get its result, continuations run in
+ * the thread setting the result, in order, or right away if it is already
+ * set, long chains of continuations do not overflow the stack, and detached
+ * threads can fan out sub-requests and fan their results back in, with one or
+ * several workers.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <uthread.h>
+
+#define NUM_WAITERS 8
+
+static uthread_future_t future;
+static int numGot;
+
+int getter(void *arg)
+{
+    void *result;
+    assert(!uthread_future_get(future, &result));
+    assert(result == arg);
+    numGot++;
+    return 0;
+}
+
+void test_waiters(void)
+{
+    uthread_t tids[NUM_WAITERS];
+    int value;
+    void *result = NULL;
+
+    future = uthread_future_create();
+    assert(future);
+    assert(uthread_future_tryget(future, &result) == -1);
+    for (int i = 0; i < NUM_WAITERS; ++i)
+        tids[i] = uthread_create(getter, &value);
+    uthread_yield();
+    assert(uthread_future_destroy(future) == -1);
+    assert(!uthread_future_set(future, &value));
+    assert(uthread_future_set(future, NULL) == -1);
+    for (int i = 0; i < NUM_WAITERS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(numGot == NUM_WAITERS);
+    assert(!uthread_future_tryget(future, &result));
+    assert(result == &value);
+    assert(!uthread_future_get(future, &result));
+    assert(result == &value);
+    assert(!uthread_future_destroy(future));
+    printf("Multiple waiters test: success.\n");
+}
+
+static uthread_t ranIn[3];
+static int numRan;
+
+void *add(void *result, void *arg)
+{
+    ranIn[numRan++] = uthread_self();
+    return (void*)((long)result + (long)arg);
+}
+
+int setter(void *arg)
+{
+    return uthread_future_set(future, (void*)1L);
+}
+
+void test_then(void)
+{
+    uthread_future_t nexts[3];
+    void *result;
+
+    future = uthread_future_create();
+    nexts[0] = uthread_future_then(future, add, (void*)10L);
+    nexts[1] = uthread_future_then(future, add, (void*)20L);
+    assert(uthread_future_tryget(nexts[0], NULL) == -1);
+
+    //run by the thread which sets the result, in order
+    uthread_t tid = uthread_create(setter, NULL);
+    assert(!uthread_join(tid, NULL));
+    assert(numRan == 2 && ranIn[0] == tid && ranIn[1] == tid);
+    assert(!uthread_future_tryget(nexts[0], &result) && (long)result == 11);
+    assert(!uthread_future_tryget(nexts[1], &result) && (long)result == 21);
+
+    //right away once it is set
+    nexts[2] = uthread_future_then(future, add, (void*)30L);
+    assert(numRan == 3 && ranIn[2] == uthread_self());
+    assert(!uthread_future_tryget(nexts[2], &result) && (long)result == 31);
+
+    for (int i = 0; i < 3; ++i)
+        assert(!uthread_future_destroy(nexts[i]));
+    assert(!uthread_future_destroy(future));
+
+    //their future must get a result first
+    future = uthread_future_create();
+    nexts[0] = uthread_future_then(future, add, (void*)10L);
+    assert(nexts[0]);
+    assert(uthread_future_destroy(future) == -1);
+    assert(!uthread_future_set(future, (void*)1L));
+    assert(!uthread_future_destroy(future));
+    assert(!uthread_future_get(nexts[0], &result) && (long)result == 11);
+    assert(!uthread_future_destroy(nexts[0]));
+    printf("Continuation test: success.\n");
+}
+
+#define CHAIN_LENGTH 100000
+
+void *increment(void *result, void *arg)
+{
+    return (void*)((long)result + 1);
+}
+
+void test_chain(void)
+{
+    uthread_future_t *chain = malloc((CHAIN_LENGTH + 1) * sizeof(uthread_future_t));
+    void *result;
+
+    chain[0] = future = uthread_future_create();
+    for (int i = 1; i <= CHAIN_LENGTH; ++i)
+        chain[i] = uthread_future_then(chain[i - 1], increment, NULL);
+    //from a thread with a regular stack
+    uthread_t tid = uthread_create(setter, NULL);
+    assert(!uthread_join(tid, NULL));
+    assert(!uthread_future_get(chain[CHAIN_LENGTH], &result));
+    assert((long)result == CHAIN_LENGTH + 1);
+    for (int i = 0; i <= CHAIN_LENGTH; ++i)
+        assert(!uthread_future_destroy(chain[i]));
+    free(chain);
+    printf("Continuation chain test: success.\n");
+}
+
+#define NUM_REQUESTS 100
+#define FAN_OUT 16
+
+struct sub_request {
+    long input;
+    uthread_future_t future;
+};
+
+int serve_sub_request(void *arg)
+{
+    struct sub_request *sub = arg;
+    uthread_yield();
+    uthread_future_set(sub->future, (void*)(sub->input * 2));
+    return 0;
+}
+
+void fan_main(void)
+{
+    uthread_attr_t attr;
+    struct sub_request subs[FAN_OUT];
+
+    uthread_attr_init(&attr);
+    uthread_attr_setdetached(&attr, 1);
+    for (int request = 0; request < NUM_REQUESTS; ++request) {
+        for (long i = 0; i < FAN_OUT; ++i) {
+            subs[i].input = i;
+            subs[i].future = uthread_future_create();
+            assert(uthread_create_attr(serve_sub_request, &subs[i], &attr) > 0);
+        }
+        long sum = 0;
+        for (int i = 0; i < FAN_OUT; ++i) {
+            void *result;
+            assert(!uthread_future_get(subs[i].future, &result));
+            sum += (long)result;
+            //even if the sub-request is still running
+            assert(!uthread_future_destroy(subs[i].future));
+        }
+        assert(sum == FAN_OUT * (FAN_OUT - 1));
+    }
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    fan_main();
+    return NULL;
+}
+
+void test_fan(void)
+{
+    pthread_t pthread;
+
+    fan_main();
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Fan-out and fan-in test: success.\n");
+}
+
+int main(void)
+{
+    test_waiters();
+    test_then();
+    test_chain();
+    test_fan();
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * I/O test
+ *
+ * A thread blocked reading a pipe or a socket lets the other threads run, a
+ * small echo server serves many connections at once, with one or several
+ * workers, a kernel thread with nothing to run sleeps until I/O is ready, and
+ * a thread keeping the CPU busy does not keep a blocked reader from waking up.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+static int pipefd[2];
+static volatile int readerDone;
+
+int reader(void *arg)
+{
+    char buf[16] = {};
+    assert(uthread_read(pipefd[0], buf, sizeof(buf)) == 5);
+    assert(!strcmp(buf, "hello"));
+    readerDone = 1;
+    return 0;
+}
+
+void test_pipe(void)
+{
+    assert(!pipe(pipefd));
+    uthread_t tid = uthread_create(reader, NULL);
+
+    //the reader blocks, but we keep running
+    for (int i = 0; i < 10; ++i)
+        uthread_yield();
+    assert(!readerDone);
+
+    assert(uthread_write(pipefd[1], "hello", 5) == 5);
+    assert(!uthread_join(tid, NULL));
+    assert(readerDone);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    printf("Pipe test: success.\n");
+}
+
+#define NUM_CLIENTS 100
+#define MESSAGE "ping"
+
+static int listenFd;
+static struct sockaddr_in serverAddr;
+
+int handler(void *arg)
+{
+    int fd = (long)arg;
+    char buf[64];
+    ssize_t len;
+
+    while((len = uthread_read(fd, buf, sizeof(buf))) > 0)
+        assert(uthread_write(fd, buf, len) == len);
+    assert(len == 0);
+    close(fd);
+    return 0;
+}
+
+int server(void *arg)
+{
+    uthread_t handlers[NUM_CLIENTS];
+
+    for (int i = 0; i < NUM_CLIENTS; ++i) {
+        long fd = uthread_accept(listenFd, NULL, NULL);
+        assert(fd >= 0);
+        handlers[i] = uthread_create(handler, (void*)fd);
+        assert(handlers[i] != -1);
+    }
+    for (int i = 0; i < NUM_CLIENTS; ++i)
+        assert(!uthread_join(handlers[i], NULL));
+    return 0;
+}
+
+int client(void *arg)
+{
+    char buf[64] = {};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    assert(!connect(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)));
+
+    assert(uthread_write(fd, MESSAGE, strlen(MESSAGE)) == strlen(MESSAGE));
+    size_t got = 0;
+    while(got < strlen(MESSAGE)){
+        ssize_t len = uthread_read(fd, buf + got, sizeof(buf) - got);
+        assert(len > 0);
+        got += len;
+    }
+    assert(!strcmp(buf, MESSAGE));
+    close(fd);
+    return 0;
+}
+
+void *echo_main(void *arg)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listenFd >= 0);
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverAddr.sin_port = 0;
+    assert(!bind(listenFd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)));
+    socklen_t len = sizeof(serverAddr);
+    assert(!getsockname(listenFd, (struct sockaddr*)&serverAddr, &len));
+    assert(!listen(listenFd, NUM_CLIENTS));
+
+    uthread_t serverTid = uthread_create(server, NULL);
+    uthread_t clients[NUM_CLIENTS];
+    for (int i = 0; i < NUM_CLIENTS; ++i)
+        clients[i] = uthread_create(client, NULL);
+    for (int i = 0; i < NUM_CLIENTS; ++i)
+        assert(!uthread_join(clients[i], NULL));
+    assert(!uthread_join(serverTid, NULL));
+    close(listenFd);
+    return NULL;
+}
+
+void test_echo(void)
+{
+    echo_main(NULL);
+    printf("Echo server test: success.\n");
+}
+
+void *echo_workers_main(void *arg)
+{
+    assert(!uthread_workers_config(2));
+    return echo_main(NULL);
+}
+
+void test_echo_workers(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, echo_workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Echo server with workers test: success.\n");
+}
+
+#define SLEEP_MS 200
+
+void *late_writer(void *arg)
+{
+    struct timespec delay = {0, SLEEP_MS * 1000000L};
+    nanosleep(&delay, NULL);
+    assert(write(pipefd[1], "hello", 5) == 5);
+    return NULL;
+}
+
+/*
+ * nothing runs until another kernel thread writes to the
+ * pipe: we must sleep rather than spin meanwhile
+ */
+void test_idle(void)
+{
+    pthread_t pthread;
+    assert(!pipe(pipefd));
+    readerDone = 0;
+    uthread_t tid = uthread_create(reader, NULL);
+    assert(!pthread_create(&pthread, NULL, late_writer, NULL));
+
+    clock_t start = clock();
+    assert(!uthread_join(tid, NULL));
+    assert(readerDone);
+    assert(clock() - start < SLEEP_MS / 4 * CLOCKS_PER_SEC / 1000);
+
+    assert(!pthread_join(pthread, NULL));
+    close(pipefd[0]);
+    close(pipefd[1]);
+    printf("Idle test: success.\n");
+}
+
+#define BUSY_TIMEOUT_MS 2000
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+/*
+ * we never yield while the reader waits: only the ticks
+ * can notice that the pipe became readable
+ */
+void test_busy(void)
+{
+    pthread_t pthread;
+    assert(!pipe(pipefd));
+    readerDone = 0;
+    uthread_t tid = uthread_create(reader, NULL);
+    uthread_yield();
+    assert(!pthread_create(&pthread, NULL, late_writer, NULL));
+
+    uint64_t end = now_ms() + BUSY_TIMEOUT_MS;
+    while(!readerDone && now_ms() < end)
+        ;
+    assert(readerDone);
+    assert(!uthread_join(tid, NULL));
+
+    assert(!pthread_join(pthread, NULL));
+    close(pipefd[0]);
+    close(pipefd[1]);
+    printf("Busy reader test: success.\n");
+}
+
+int main(void)
+{
+    test_pipe();
+    test_echo();
+    test_idle();
+    test_busy();
+    test_echo_workers();
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iqueue.h>
+
+#define TEST_ELEMENT_NUM 10
+
+typedef struct item {
+    int value;
+    iqueue_link_t link;
+} item;
+
+static int dequeue_value(iqueue_t *queue)
+{
+    iqueue_link_t *link = iqueue_dequeue(queue);
+    assert(link);
+    return iqueue_entry(link, item, link)->value;
+}
+
+/*
+ * enqueue 10 items, and dequeue them in the same order
+ */
+void test_enqueue_dequeue()
+{
+    iqueue_t queue;
+    item items[TEST_ELEMENT_NUM];
+    iqueue_init(&queue);
+    assert(iqueue_length(&queue) == 0);
+    assert(!iqueue_dequeue(&queue));
+
+    for (int i = 0; i < TEST_ELEMENT_NUM; ++i) {
+        items[i].value = i;
+        iqueue_enqueue(&queue, &items[i].link);
+        assert(iqueue_length(&queue) == i + 1);
+    }
+    assert(iqueue_entry(iqueue_peek(&queue), item, link) == &items[0]);
+    for (int i = 0; i < TEST_ELEMENT_NUM; ++i) {
+        assert(dequeue_value(&queue) == i);
+        assert(iqueue_length(&queue) == TEST_ELEMENT_NUM - i - 1);
+    }
+    assert(!iqueue_peek(&queue));
+    printf("Intrusive queue enqueue and dequeue test: success.\n");
+}
+
+/*
+ * remove the head, the tail and items in the middle,
+ * then check the order of what is left
+ */
+void test_remove()
+{
+    iqueue_t queue;
+    item items[TEST_ELEMENT_NUM];
+    iqueue_init(&queue);
+    for (int i = 0; i < TEST_ELEMENT_NUM; ++i) {
+        items[i].value = i;
+        iqueue_enqueue(&queue, &items[i].link);
+    }
+
+    iqueue_remove(&queue, &items[0].link);
+    iqueue_remove(&queue, &items[TEST_ELEMENT_NUM - 1].link);
+    for (int i = 2; i < TEST_ELEMENT_NUM - 1; i += 2)
+        iqueue_remove(&queue, &items[i].link);
+    assert(iqueue_length(&queue) == 4);
+
+    //a removed item can be enqueued again
+    iqueue_enqueue(&queue, &items[0].link);
+
+    assert(dequeue_value(&queue) == 1);
+    assert(dequeue_value(&queue) == 3);
+    assert(dequeue_value(&queue) == 5);
+    assert(dequeue_value(&queue) == 7);
+    assert(dequeue_value(&queue) == 0);
+    assert(iqueue_length(&queue) == 0);
+    printf("Intrusive queue remove test: success.\n");
+}
+
+int main()
+{
+    test_enqueue_dequeue();
+    test_remove();
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Lazy stack test
+ *
+ * Threads which were created but did not run yet have no stack, so a burst of
+ * creations costs little memory. They get a stack when they first run, with
+ * the requested size, and threads which never run, because their scheduler is
+ * destroyed first, are freed all the same. A thread whose stack cannot be
+ * allocated finishes with -1 without running.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <uthread.h>
+
+#define NUM_THREADS 20000
+#define MAX_GROWTH_KB (40 * 1024)
+
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static int numRan;
+
+int touch_stack(void *arg)
+{
+    char buffer[4096];
+    memset(buffer, 1, sizeof(buffer));
+    numRan++;
+    return buffer[sizeof(buffer) - 1];
+}
+
+void test_burst(void)
+{
+    static uthread_t tids[NUM_THREADS];
+
+    long before = max_rss_kb();
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        tids[i] = uthread_create(touch_stack, NULL);
+        assert(tids[i] > 0);
+    }
+    assert(numRan == 0);
+    assert(max_rss_kb() - before < MAX_GROWTH_KB);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(numRan == NUM_THREADS);
+    printf("Creation burst test: success.\n");
+}
+
+/*
+ * each level uses about 1 KiB of stack
+ */
+int recurse(void *arg)
+{
+    volatile char frame[1024];
+    long depth = (long)arg;
+    memset((char*)frame, 1, sizeof(frame));
+    if(depth == 0)
+        return frame[0];
+    return recurse((void*)(depth - 1)) + frame[sizeof(frame) - 1] - 1;
+}
+
+void test_stack_size(void)
+{
+    uthread_attr_t attr;
+    int retval = -1;
+
+    uthread_attr_init(&attr);
+    assert(!uthread_attr_setstacksize(&attr, 1 << 20));
+    int tid = uthread_create_attr(recurse, (void*)512L, &attr);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == 1);
+    printf("Lazy stack size test: success.\n");
+}
+
+void test_stack_failure(void)
+{
+    uthread_attr_t attr;
+    int retval = 0;
+
+    //more than the address space
+    uthread_attr_init(&attr);
+    assert(!uthread_attr_setstacksize(&attr, (size_t)1 << 60));
+    numRan = 0;
+
+    //we wait for it when it fails
+    int tid = uthread_create_attr(touch_stack, NULL, &attr);
+    assert(tid > 0);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == -1);
+
+    //it fails while we are ready
+    retval = 0;
+    tid = uthread_create_attr(touch_stack, NULL, &attr);
+    uthread_yield();
+    assert(!uthread_join(tid, &retval));
+    assert(retval == -1);
+
+    //nobody waits for it
+    assert(!uthread_attr_setdetached(&attr, 1));
+    tid = uthread_create_attr(touch_stack, NULL, &attr);
+    assert(tid > 0);
+    uthread_yield();
+    assert(uthread_join(tid, NULL) == -1);
+
+    assert(numRan == 0);
+    printf("Stack allocation failure test: success.\n");
+}
+
+void *never_run_main(void *arg)
+{
+    for (int i = 0; i < 1000; ++i)
+        assert(uthread_create(touch_stack, NULL) > 0);
+    //the kernel thread exits with its scheduler, and the threads
+    return NULL;
+}
+
+void test_never_run(void)
+{
+    pthread_t pthread;
+
+    numRan = 0;
+    assert(!pthread_create(&pthread, NULL, never_run_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    assert(numRan == 0);
+    printf("Never run test: success.\n");
+}
+
+int main(void)
+{
+    //nothing runs before we let it
+    assert(!uthread_preempt_config(0, UTHREAD_PREEMPT_MONOTONIC));
+    test_burst();
+    test_stack_size();
+    test_stack_failure();
+    test_never_run();
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * MPMC queue test
+ *
+ * Single-threaded: FIFO order, full and empty queues, error cases.
+ * Multi-threaded: several pthreads produce and consume at the same time, and
+ * every item must be consumed exactly once.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpmc_queue.h>
+
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define ITEMS_PER_PRODUCER 100000
+#define TOTAL_ITEMS (NUM_PRODUCERS * ITEMS_PER_PRODUCER)
+
+void test_sequential()
+{
+    int data[8];
+    void *tmp;
+
+    assert(!mpmc_queue_create(0));
+    mpmc_queue_t queue = mpmc_queue_create(5);
+    assert(queue);
+    assert(mpmc_queue_length(queue) == 0);
+    assert(mpmc_queue_dequeue(queue, &tmp) == -1);
+
+    //capacity was rounded up to 8
+    for (int i = 0; i < 8; ++i)
+        assert(!mpmc_queue_enqueue(queue, &data[i]));
+    assert(mpmc_queue_enqueue(queue, &data[0]) == -1);
+    assert(mpmc_queue_length(queue) == 8);
+    assert(mpmc_queue_destroy(queue) == -1);
+
+    //wrap around a few times
+    for (int lap = 0; lap < 3; ++lap) {
+        for (int i = 0; i < 8; ++i) {
+            assert(!mpmc_queue_dequeue(queue, &tmp));
+            assert(tmp == &data[i]);
+            assert(!mpmc_queue_enqueue(queue, &data[i]));
+        }
+    }
+    for (int i = 0; i < 8; ++i)
+        assert(!mpmc_queue_dequeue(queue, &tmp) && tmp == &data[i]);
+
+    assert(mpmc_queue_enqueue(NULL, &data[0]) == -1);
+    assert(mpmc_queue_enqueue(queue, NULL) == -1);
+    assert(mpmc_queue_dequeue(NULL, &tmp) == -1);
+    assert(mpmc_queue_dequeue(queue, NULL) == -1);
+    assert(mpmc_queue_length(NULL) == -1);
+    assert(mpmc_queue_destroy(NULL) == -1);
+    assert(!mpmc_queue_destroy(queue));
+    printf("Sequential MPMC queue test: success.\n");
+}
+
+mpmc_queue_t sharedQueue;
+atomic_int seen[TOTAL_ITEMS];
+atomic_int consumed;
+
+void *producer(void *arg)
+{
+    uintptr_t first = (uintptr_t)arg * ITEMS_PER_PRODUCER;
+    for (uintptr_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        //items are 1-based, NULL cannot be enqueued
+        while(mpmc_queue_enqueue(sharedQueue, (void*)(first + i + 1)))
+            sched_yield();
+    }
+    return NULL;
+}
+
+void *consumer(void *arg)
+{
+    void *item;
+    while(atomic_load(&consumed) < TOTAL_ITEMS) {
+        if(mpmc_queue_dequeue(sharedQueue, &item)){
+            sched_yield();
+            continue;
+        }
+        atomic_fetch_add(&seen[(uintptr_t)item - 1], 1);
+        atomic_fetch_add(&consumed, 1);
+    }
+    return NULL;
+}
+
+void test_concurrent()
+{
+    pthread_t producers[NUM_PRODUCERS], consumers[NUM_CONSUMERS];
+    sharedQueue = mpmc_queue_create(1024);
+    assert(sharedQueue);
+
+    for (long i = 0; i < NUM_CONSUMERS; ++i)
+        assert(!pthread_create(&consumers[i], NULL, consumer, NULL));
+    for (long i = 0; i < NUM_PRODUCERS; ++i)
+        assert(!pthread_create(&producers[i], NULL, producer, (void*)i));
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+        pthread_join(producers[i], NULL);
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+        pthread_join(consumers[i], NULL);
+
+    for (int i = 0; i < TOTAL_ITEMS; ++i)
+        assert(atomic_load(&seen[i]) == 1);
+    assert(!mpmc_queue_destroy(sharedQueue));
+    printf("Concurrent MPMC queue test: success.\n");
+}
+
+int main()
+{
+    test_sequential();
+    test_concurrent();
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Thread pool test
+ *
+ * Tasks return their value to whoever waits for them, whether they finished
+ * already or not, start in the order they were submitted, may block and submit
+ * other tasks, all run before the pool is destroyed, and run on one or several
+ * workers.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include <uthread.h>
+
+#define NUM_THREADS 4
+#define NUM_TASKS 10000
+
+static atomic_int numRun;
+
+int square(void *arg)
+{
+    long x = (long)arg;
+    atomic_fetch_add(&numRun, 1);
+    return x * x;
+}
+
+void pool_main(void)
+{
+    static uthread_task_t tasks[NUM_TASKS];
+    int retval;
+
+    uthread_pool_t pool = uthread_pool_create(NUM_THREADS);
+    assert(pool);
+    atomic_store(&numRun, 0);
+    for (long i = 0; i < NUM_TASKS; ++i) {
+        tasks[i] = uthread_pool_submit(pool, square, (void*)(i % 1000));
+        assert(tasks[i]);
+    }
+    for (long i = 0; i < NUM_TASKS; ++i) {
+        assert(!uthread_task_wait(tasks[i], &retval));
+        assert(retval == (i % 1000) * (i % 1000));
+    }
+    assert(atomic_load(&numRun) == NUM_TASKS);
+    assert(!uthread_pool_destroy(pool));
+}
+
+void test_results(void)
+{
+    assert(!uthread_pool_create(0));
+    assert(!uthread_pool_submit(NULL, square, NULL));
+    assert(uthread_task_wait(NULL, NULL) == -1);
+    assert(uthread_pool_destroy(NULL) == -1);
+
+    pool_main();
+
+    //a finished task
+    uthread_pool_t pool = uthread_pool_create(1);
+    uthread_task_t task = uthread_pool_submit(pool, square, (void*)3L);
+    int retval = -1;
+    while(atomic_load(&numRun) != NUM_TASKS + 1)
+        uthread_yield();
+    assert(!uthread_task_wait(task, &retval));
+    assert(retval == 9);
+    assert(!uthread_pool_destroy(pool));
+    printf("Task results test: success.\n");
+}
+
+static int order[NUM_THREADS * 4];
+static int numStarted;
+
+int record(void *arg)
+{
+    order[numStarted++] = (long)arg;
+    return 0;
+}
+
+void test_order(void)
+{
+    uthread_task_t tasks[NUM_THREADS * 4];
+
+    uthread_pool_t pool = uthread_pool_create(1);
+    for (long i = 0; i < NUM_THREADS * 4; ++i)
+        tasks[i] = uthread_pool_submit(pool, record, (void*)i);
+    for (int i = 0; i < NUM_THREADS * 4; ++i)
+        assert(!uthread_task_wait(tasks[i], NULL));
+    for (int i = 0; i < NUM_THREADS * 4; ++i)
+        assert(order[i] == i);
+    assert(!uthread_pool_destroy(pool));
+    printf("Task order test: success.\n");
+}
+
+static uthread_pool_t nestedPool;
+static uthread_sem_t gate;
+
+int blocker(void *arg)
+{
+    uthread_sem_down(&gate);
+    return 1;
+}
+
+int spawner(void *arg)
+{
+    int retval;
+    //the other pool thread runs it meanwhile
+    uthread_task_t task = uthread_pool_submit(nestedPool, blocker, NULL);
+    uthread_sem_up(&gate);
+    assert(!uthread_task_wait(task, &retval));
+    return retval + 1;
+}
+
+void test_nested(void)
+{
+    int retval;
+
+    assert(!uthread_sem_init(&gate, 0));
+    nestedPool = uthread_pool_create(2);
+    uthread_task_t task = uthread_pool_submit(nestedPool, spawner, NULL);
+    assert(!uthread_task_wait(task, &retval));
+    assert(retval == 2);
+    assert(!uthread_pool_destroy(nestedPool));
+    printf("Nested task test: success.\n");
+}
+
+void test_destroy(void)
+{
+    uthread_pool_t pool = uthread_pool_create(NUM_THREADS);
+    atomic_store(&numRun, 0);
+    for (int i = 0; i < NUM_TASKS; ++i)
+        assert(uthread_pool_submit(pool, square, NULL));
+    //never waited for, but run anyway
+    assert(!uthread_pool_destroy(pool));
+    assert(atomic_load(&numRun) == NUM_TASKS);
+    printf("Pool destroy test: success.\n");
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    pool_main();
+    return NULL;
+}
+
+void test_workers(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Thread pool with workers test: success.\n");
+}
+
+int main(void)
+{
+    test_results();
+    test_order();
+    test_nested();
+    test_destroy();
+    test_workers();
+    return 0;
+}
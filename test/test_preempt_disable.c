@@ -0,0 +1,90 @@
+/*
+ * Preemption disable test
+ *
+ * Nested preempt_disable() calls keep the main thread running past several
+ * timer ticks, and the yield deferred by those ticks happens as soon as the
+ * outermost preempt_enable() is called. A tick deferred until a switch is not
+ * charged to the thread switched to. Ticks are raised by hand, with the timer
+ * off, so that they arrive exactly where the test wants them.
+ */
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include <iqueue.h>
+#include <preempt.h>
+#include <scheduler.h>
+#include <uthread.h>
+
+static volatile int threadRan = 0;
+
+int thread(void *arg)
+{
+    threadRan = 1;
+    return 0;
+}
+
+void test_deferred_tick(void)
+{
+    uthread_t tid = uthread_create(thread, NULL);
+
+    preempt_disable();
+    preempt_disable();
+    raise(SIGVTALRM);
+    assert(!threadRan);
+
+    preempt_enable();
+    raise(SIGVTALRM);
+    assert(!threadRan);
+
+    preempt_enable();
+    assert(threadRan);
+
+    assert(!uthread_join(tid, NULL));
+    printf("Deferred tick test: success.\n");
+}
+
+static iqueue_t mainQueue;
+static volatile int firstRan = 0;
+
+int first(void *arg)
+{
+    firstRan = 1;
+    preempt_disable();
+    sched_wake(iqueue_dequeue(&mainQueue));
+    preempt_enable();
+    return 0;
+}
+
+int second(void *arg)
+{
+    //the first one would have yielded to us right away with the tick of main
+    assert(firstRan);
+    return 0;
+}
+
+void test_stale_tick(void)
+{
+    uthread_t tid1 = uthread_create(first, NULL);
+    uthread_t tid2 = uthread_create(second, NULL);
+
+    iqueue_init(&mainQueue);
+    preempt_disable();
+    raise(SIGVTALRM);
+    sched_block(&mainQueue);
+    preempt_enable();
+
+    assert(!uthread_join(tid1, NULL));
+    assert(!uthread_join(tid2, NULL));
+    printf("Stale tick test: success.\n");
+}
+
+int main()
+{
+    //the timer exists, but only our ticks come in
+    assert(!uthread_preempt_config(0, UTHREAD_PREEMPT_CPU));
+    test_deferred_tick();
+    test_stale_tick();
+    return 0;
+}
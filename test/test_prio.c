@@ -0,0 +1,114 @@
+/*
+ * Priority scheduling test
+ *
+ * More urgent threads run first, setting a priority takes effect right away,
+ * and per-priority time slices make threads switch less often.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <uthread.h>
+
+static char order[16];
+static int orderLen;
+
+int record(void *arg)
+{
+    order[orderLen++] = *(char*)arg;
+    return 0;
+}
+
+void test_order(void)
+{
+    assert(uthread_getprio(0) == UTHREAD_PRIO_LEVELS_DEFAULT / 2);
+    assert(uthread_prio_config(4) == -1);
+
+    uthread_t a = uthread_create(record, "A");
+    assert(uthread_getprio(a) == uthread_getprio(0));
+    assert(!uthread_setprio(a, 2));
+    assert(uthread_getprio(a) == 2);
+
+    //B becomes more urgent than us and runs right away
+    uthread_t b = uthread_create(record, "B");
+    assert(!uthread_setprio(b, 6));
+    assert(!strcmp(order, "B"));
+
+    //C has our priority, A has to wait until we block
+    uthread_t c = uthread_create(record, "C");
+    uthread_yield();
+    assert(!strcmp(order, "BC"));
+
+    assert(!uthread_join(a, NULL));
+    assert(!strcmp(order, "BCA"));
+    assert(!uthread_join(b, NULL));
+    assert(!uthread_join(c, NULL));
+
+    assert(uthread_setprio(0, -1) == -1);
+    assert(uthread_setprio(0, UTHREAD_PRIO_LEVELS_DEFAULT) == -1);
+    assert(uthread_setprio(a, 1) == -1);
+    assert(uthread_getprio(a) == -1);
+    printf("Priority order test: success.\n");
+}
+
+#define SPIN_MS 200
+
+static volatile int lastRunner;
+static volatile int switches;
+
+/*
+ * spin for a while of CPU time, counting how many times
+ * the CPU went back and forth between the spinners
+ */
+int spinner(void *arg)
+{
+    int self = *(int*)arg;
+    clock_t end = clock() + SPIN_MS * CLOCKS_PER_SEC / 1000;
+
+    while(clock() < end){
+        if(lastRunner != self){
+            lastRunner = self;
+            switches++;
+        }
+    }
+    return 0;
+}
+
+int count_switches(int prio)
+{
+    static int ids[2] = {1, 2};
+    lastRunner = 0;
+    switches = 0;
+
+    uthread_t tids[2];
+    for (int i = 0; i < 2; ++i) {
+        tids[i] = uthread_create(spinner, &ids[i]);
+        assert(!uthread_setprio(tids[i], prio));
+    }
+    for (int i = 0; i < 2; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    return switches;
+}
+
+void test_slice(void)
+{
+    assert(uthread_prio_setslice(-1, 1) == -1);
+    assert(uthread_prio_setslice(UTHREAD_PRIO_LEVELS_DEFAULT, 1) == -1);
+    assert(uthread_prio_setslice(1, 0) == -1);
+
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_CPU));
+    assert(!uthread_prio_setslice(1, 50));
+    int shortSlices = count_switches(2);
+    int longSlices = count_switches(1);
+    assert(longSlices * 5 < shortSlices);
+    printf("Priority time slice test: success.\n");
+}
+
+int main()
+{
+    test_order();
+    test_slice();
+    return 0;
+}
@@ -7,13 +7,23 @@
 #define NORMAL_TEST_ELEMENT_NUM 10
 #define COMPLEX_TEST_ELEMENT_NUM 1000000
 
+/*
+ * every test runs once per queue implementation
+ */
+queue_type_t testType;
+
+queue_t test_queue_create()
+{
+    return queue_create_type(testType);
+}
+
 /*
  * this test we want to test what will happen
  * if we enqueue an element multiple times and delete it
  */
 void test_delete_complex()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     int tmp = 0;
     assert(!queue_enqueue(new, (void*)&tmp));
     assert(!queue_enqueue(new, (void*)&tmp));
@@ -53,7 +63,7 @@ int initialize_sid(void *data, void *arg)
  */
 void test_iterate_complex()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     sid *students = malloc(COMPLEX_TEST_ELEMENT_NUM * sizeof(sid));
     for (int i = 0; i < COMPLEX_TEST_ELEMENT_NUM; ++i) {
         students[i].firstChar = '\0';
@@ -91,7 +101,7 @@ void test_iterate_complex()
  */
 void test_enqueue_dequeue_complex()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     int *data = malloc(COMPLEX_TEST_ELEMENT_NUM * sizeof(int));
     for (int i = 0; i < COMPLEX_TEST_ELEMENT_NUM/2; ++i) {
         assert(!queue_enqueue(new, (void*)&data[i]));
@@ -117,6 +127,50 @@ void test_enqueue_dequeue_complex()
     printf("Complex queue enqueue and dequeue test: success.\n");
 }
 
+/*
+ * Enqueue and dequeue in batches of different sizes,
+ * interleaved with single operations, so that the
+ * ring buffer wraps around and grows while not empty.
+ * Items must come out in the exact order they went in.
+ */
+void test_batch_complex()
+{
+    queue_t new = test_queue_create();
+    int *data = malloc(COMPLEX_TEST_ELEMENT_NUM * sizeof(int));
+    void *batch[100];
+    int in = 0, out = 0;
+
+    while(out < COMPLEX_TEST_ELEMENT_NUM) {
+        int count = rand() % 100;
+        if(count > COMPLEX_TEST_ELEMENT_NUM - in)
+            count = COMPLEX_TEST_ELEMENT_NUM - in;
+        for (int i = 0; i < count; ++i)
+            batch[i] = &data[in + i];
+        assert(!queue_enqueue_batch(new, batch, count));
+        in += count;
+        if(in < COMPLEX_TEST_ELEMENT_NUM)
+            assert(!queue_enqueue(new, &data[in++]));
+        assert(queue_length(new) == in - out);
+
+        //dequeue a bit less than we enqueued, then catch up at the end
+        int wanted = rand() % 100;
+        int got = queue_dequeue_batch(new, batch, wanted);
+        assert(got == (wanted < in - out ? wanted : in - out));
+        for (int i = 0; i < got; ++i)
+            assert(batch[i] == &data[out + i]);
+        out += got;
+        if(out < in){
+            void *tmp;
+            assert(!queue_dequeue(new, &tmp));
+            assert(tmp == &data[out++]);
+        }
+    }
+    assert(queue_dequeue_batch(new, batch, 10) == 0);
+    free(data);
+    assert(!queue_destroy(new));
+    printf("Complex queue batch test: success.\n");
+}
+
 /*
  * This test is to test some special cases
  * or corner cases
@@ -128,6 +182,8 @@ void complex_test()
     test_iterate_complex();
 
     test_delete_complex();
+
+    test_batch_complex();
 }
 
 /*
@@ -155,7 +211,7 @@ void test_iterate_error()
     queue_t new = NULL;
     assert(queue_iterate(new, do_nothing, NULL, NULL) == -1);
 
-    new = queue_create();
+    new = test_queue_create();
     assert(queue_iterate(new, NULL, NULL, NULL) == -1);
     printf("Error queue iterate test: success.\n");
 }
@@ -174,7 +230,7 @@ void test_delete_error()
     assert(queue_delete(new, (void*)&a) == -1);
 
     //second case
-    new = queue_create();
+    new = test_queue_create();
     assert(!queue_enqueue(new, (void*)&a));
     assert(queue_delete(new, NULL) == -1);
 
@@ -199,7 +255,7 @@ void test_dequeue_error()
     assert(tmp && queue_dequeue(new, (void**)&tmp) == -1);
 
     //second case
-    new = queue_create();
+    new = test_queue_create();
     assert(queue_dequeue(new, NULL) == -1);
 
     //third case
@@ -226,7 +282,7 @@ void test_enqueue_error()
     assert(queue_enqueue(new, NULL) == -1);
 
     //third case
-    new = queue_create();
+    new = test_queue_create();
     assert(queue_enqueue(new, NULL) == -1);
     printf("Error queue enqueue test: success.\n");
 }
@@ -244,7 +300,7 @@ void test_destroy_error()
 
     //destroy an non-empty queue
     int tmp;
-    new = queue_create();
+    new = test_queue_create();
     queue_enqueue(new, (void*)&tmp);
     //length of queue should be greater than 0
     //call queue_destroy on an non-empty queue should return -1
@@ -257,6 +313,33 @@ void test_destroy_error()
     printf("Error queue destroy test: success.\n");
 }
 
+/*
+ * Cases:
+ * 1, queue == NULL or data == NULL
+ * 2, negative count
+ * 3, one item of the batch is NULL: nothing is enqueued
+ */
+void test_batch_error()
+{
+    void *batch[2];
+    int a;
+    assert(queue_enqueue_batch(NULL, batch, 1) == -1);
+    assert(queue_dequeue_batch(NULL, batch, 1) == -1);
+
+    queue_t new = test_queue_create();
+    assert(queue_enqueue_batch(new, NULL, 1) == -1);
+    assert(queue_dequeue_batch(new, NULL, 1) == -1);
+    assert(queue_enqueue_batch(new, batch, -1) == -1);
+    assert(queue_dequeue_batch(new, batch, -1) == -1);
+
+    batch[0] = &a;
+    batch[1] = NULL;
+    assert(queue_enqueue_batch(new, batch, 2) == -1);
+    assert(queue_length(new) == 0);
+    assert(!queue_destroy(new));
+    printf("Error queue batch test: success.\n");
+}
+
 /*
  * this test is testing what happen if we
  * deliberately use API of queue in a wrong way.
@@ -279,6 +362,8 @@ void error_test()
     test_iterate_error();
 
     test_length_error();
+
+    test_batch_error();
 }
 
 /*
@@ -303,7 +388,7 @@ int normal_find_int(void *data, void *arg)
  */
 void test_iterate()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     int *data = malloc(NORMAL_TEST_ELEMENT_NUM * sizeof(int));
     for (int i = 0; i < NORMAL_TEST_ELEMENT_NUM; ++i) {
         data[i] = i;
@@ -336,7 +421,7 @@ void test_iterate()
  */
 void test_delete()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     //we have used int, what about double this time?
     double *data = malloc(NORMAL_TEST_ELEMENT_NUM * sizeof(double));
     for (int i = 0; i < NORMAL_TEST_ELEMENT_NUM; ++i) {
@@ -369,7 +454,7 @@ void test_delete()
  */
 void test_length()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     assert(!queue_length(new));
     for (int i = 0; i < NORMAL_TEST_ELEMENT_NUM; ++i) {
         //we don't really care about what we enqueue in this test
@@ -392,7 +477,7 @@ void test_length()
  */
 void test_enqueue_dequeue()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     int *data = malloc(NORMAL_TEST_ELEMENT_NUM * sizeof(int));
     int retval;
     for (int i = 0; i < NORMAL_TEST_ELEMENT_NUM; ++i) {
@@ -420,7 +505,7 @@ void test_enqueue_dequeue()
  */
 void test_create_destroy()
 {
-    queue_t new = queue_create();
+    queue_t new = test_queue_create();
     assert(new);
     int retval = queue_destroy(new);
     assert(!retval);
@@ -448,9 +533,17 @@ void normal_test()
 int main() {
     srand(time(0));
 
-    normal_test();
+    queue_type_t types[] = {QUEUE_LIST, QUEUE_RING};
+    const char *names[] = {"list", "ring"};
+    for (int i = 0; i < 2; ++i) {
+        testType = types[i];
+        printf("Testing %s queue\n", names[i]);
+
+        normal_test();
 
-    error_test();
+        error_test();
 
-    complex_test();
+        complex_test();
+    }
+    assert(!queue_create_type(-1));
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rbtree.h>
+
+#define TEST_ELEMENT_NUM 10000
+#define TEST_KEY_RANGE 100
+
+typedef struct item {
+    int key;
+    int seq; //insertion order
+    bool inTree;
+    rbtree_node_t node;
+} item;
+
+static bool item_less(const rbtree_node_t *a, const rbtree_node_t *b)
+{
+    return rbtree_entry(a, item, node)->key < rbtree_entry(b, item, node)->key;
+}
+
+/*
+ * check the red-black invariants below @node
+ * Return value:
+ * black height of @node
+ */
+static int check_node(rbtree_node_t *node, rbtree_node_t *parent)
+{
+    if(!node)
+        return 1;
+    assert(node->parent == parent);
+    if(node->red)
+        assert(!(node->left && node->left->red) && !(node->right && node->right->red));
+    int left = check_node(node->left, node);
+    int right = check_node(node->right, node);
+    assert(left == right);
+    return left + !node->red;
+}
+
+/*
+ * check the invariants, and that walking the tree
+ * gives keys in order, equal keys in insertion order
+ */
+static void check_tree(rbtree_t *tree, int expectedCount)
+{
+    assert(!tree->root || !tree->root->red);
+    check_node(tree->root, NULL);
+
+    int count = 0;
+    item *prev = NULL;
+    for (rbtree_node_t *node = rbtree_first(tree); node; node = rbtree_next(node)) {
+        item *cur = rbtree_entry(node, item, node);
+        assert(cur->inTree);
+        if(prev)
+            assert(prev->key < cur->key || (prev->key == cur->key && prev->seq < cur->seq));
+        prev = cur;
+        ++count;
+    }
+    assert(count == expectedCount);
+    assert(rbtree_count(tree) == expectedCount);
+}
+
+/*
+ * insert items in order, then remove them from the front
+ */
+void test_sorted()
+{
+    rbtree_t tree;
+    item items[TEST_ELEMENT_NUM];
+    rbtree_init(&tree);
+    assert(!rbtree_first(&tree));
+
+    for (int i = 0; i < TEST_ELEMENT_NUM; ++i) {
+        items[i] = (item){.key = i, .seq = i, .inTree = true};
+        rbtree_insert(&tree, &items[i].node, item_less);
+    }
+    check_tree(&tree, TEST_ELEMENT_NUM);
+    for (int i = 0; i < TEST_ELEMENT_NUM; ++i) {
+        rbtree_node_t *first = rbtree_first(&tree);
+        assert(first == &items[i].node);
+        rbtree_remove(&tree, first);
+        items[i].inTree = false;
+    }
+    check_tree(&tree, 0);
+    assert(!rbtree_first(&tree));
+    printf("Red-black tree sorted test: success.\n");
+}
+
+/*
+ * insert and remove random items, with many equal keys
+ */
+void test_random()
+{
+    rbtree_t tree;
+    static item items[TEST_ELEMENT_NUM];
+    int count = 0, seq = 0;
+    rbtree_init(&tree);
+    srand(42);
+
+    for (int round = 0; round < 4 * TEST_ELEMENT_NUM; ++round) {
+        item *it = &items[rand() % TEST_ELEMENT_NUM];
+        if(it->inTree){
+            rbtree_remove(&tree, &it->node);
+            it->inTree = false;
+            --count;
+        }else{
+            it->key = rand() % TEST_KEY_RANGE;
+            it->seq = seq++;
+            it->inTree = true;
+            rbtree_insert(&tree, &it->node, item_less);
+            ++count;
+        }
+        if(round % 1000 == 0)
+            check_tree(&tree, count);
+    }
+    check_tree(&tree, count);
+    printf("Red-black tree random test: success.\n");
+}
+
+int main()
+{
+    test_sorted();
+    test_random();
+    return 0;
+}
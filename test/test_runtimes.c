@@ -0,0 +1,178 @@
+/*
+ * Independent schedulers test
+ *
+ * Several pthreads each run threads of their own at the same time: each one
+ * gets a scheduler with its own TIDs, settings and preemption timer, and the
+ * scheduler goes away with its pthread, along with its workers.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <preempt.h>
+#include <uthread.h>
+
+#define NUM_SHARDS 4
+#define NUM_THREADS 8
+#define YIELDS 100
+
+struct shard {
+    int index;
+    volatile int threadRan;
+    long counter;
+};
+
+static __thread struct shard *thisShard;
+
+int yielder(void *arg)
+{
+    struct shard *shard = arg;
+    for (int i = 0; i < YIELDS; ++i) {
+        //only threads of our shard run here
+        assert(thisShard == shard);
+        shard->counter++;
+        uthread_yield();
+    }
+    return shard->index;
+}
+
+int thread(void *arg)
+{
+    struct shard *shard = arg;
+    shard->threadRan = 1;
+    return 0;
+}
+
+void *shard_main(void *arg)
+{
+    struct shard *shard = arg;
+    thisShard = shard;
+
+    //settings are our own
+    assert(!uthread_prio_config(2 + shard->index));
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_MONOTONIC));
+    assert(uthread_self() == 0);
+
+    uthread_t tids[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        tids[i] = uthread_create(yielder, shard);
+        //TIDs are not shared with other shards
+        assert(tids[i] == i + 1);
+    }
+    assert(uthread_getprio(0) == (2 + shard->index) / 2);
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        int retval;
+        assert(!uthread_join(tids[i], &retval));
+        assert(retval == shard->index);
+    }
+    assert(shard->counter == NUM_THREADS * YIELDS);
+
+    //our timer preempts us while we busy wait
+    uthread_t tid = uthread_create(thread, shard);
+    assert(preempt_armed());
+    while(!shard->threadRan)
+        ;
+    assert(!uthread_join(tid, NULL));
+    return NULL;
+}
+
+void test_shards(void)
+{
+    pthread_t pthreads[NUM_SHARDS];
+    struct shard shards[NUM_SHARDS] = {};
+
+    for (int i = 0; i < NUM_SHARDS; ++i) {
+        shards[i].index = i;
+        assert(!pthread_create(&pthreads[i], NULL, shard_main, &shards[i]));
+    }
+    for (int i = 0; i < NUM_SHARDS; ++i)
+        assert(!pthread_join(pthreads[i], NULL));
+    printf("Independent schedulers test: success.\n");
+}
+
+/*
+ * schedulers are freed with their pthread, timers included,
+ * so pthreads can come and go
+ */
+void test_lifetime(void)
+{
+    for (int i = 0; i < 200; ++i) {
+        pthread_t pthread;
+        struct shard shard = {.index = 0};
+        assert(!pthread_create(&pthread, NULL, shard_main, &shard));
+        assert(!pthread_join(pthread, NULL));
+    }
+    printf("Scheduler lifetime test: success.\n");
+}
+
+int forever(void *arg)
+{
+    while(1)
+        uthread_yield();
+    return 0;
+}
+
+int few_yields(void *arg)
+{
+    for (int i = 0; i < YIELDS; ++i)
+        uthread_yield();
+    return 0;
+}
+
+int sleep_long(void *arg)
+{
+    uthread_sleep_ns(3600 * 1000000000ull);
+    return 0;
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    //left behind, running or sleeping, when we exit
+    assert(uthread_create(forever, NULL) > 0);
+    assert(uthread_create(sleep_long, NULL) > 0);
+    uthread_t tid = uthread_create(few_yields, NULL);
+    assert(!uthread_join(tid, NULL));
+    return NULL;
+}
+
+static int num_kernel_threads(void)
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/task");
+    assert(dir);
+    while(readdir(dir))
+        count++;
+    closedir(dir);
+    //. and ..
+    return count - 2;
+}
+
+/*
+ * the workers exit with the pthread which started them
+ */
+void test_workers_lifetime(void)
+{
+    for (int i = 0; i < 50; ++i) {
+        pthread_t pthread;
+        assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+        assert(!pthread_join(pthread, NULL));
+        assert(num_kernel_threads() == 1);
+    }
+    printf("Workers lifetime test: success.\n");
+}
+
+int main(void)
+{
+    //the main kernel thread is a shard like any other
+    test_shards();
+    test_lifetime();
+    test_workers_lifetime();
+    thisShard = NULL;
+    uthread_t tid = uthread_create(thread, &(struct shard){});
+    assert(tid == 1);
+    assert(!uthread_join(tid, NULL));
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Shared stack test
+ *
+ * Threads running on the shared stack keep their stack frames intact across
+ * yields, whether they get switched to another shared-stack thread, to a
+ * thread with its own stack, or preempted.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uthread.h>
+
+#define NUM_THREADS 100
+#define NUM_YIELDS 5
+
+/*
+ * fill a frame per level with a pattern, yield at the
+ * deepest level, then check every level on the way up
+ */
+int nested_yield(int depth, unsigned char pattern)
+{
+    unsigned char frame[256];
+    memset(frame, pattern + depth, sizeof(frame));
+
+    int corrupted = 0;
+    if(depth == 0){
+        for (int i = 0; i < NUM_YIELDS; ++i)
+            uthread_yield();
+    } else {
+        corrupted = nested_yield(depth - 1, pattern);
+    }
+
+    for (int i = 0; i < sizeof(frame); ++i)
+        if(frame[i] != (unsigned char)(pattern + depth))
+            return corrupted + 1;
+    return corrupted;
+}
+
+int shared_thread(void *arg)
+{
+    long id = (long)arg;
+    return nested_yield(id % 16, (unsigned char)id);
+}
+
+void test_yield()
+{
+    uthread_attr_t shared, dedicated;
+    assert(!uthread_attr_init(&shared));
+    assert(!uthread_attr_setsharedstack(&shared, 1));
+    assert(!uthread_attr_init(&dedicated));
+
+    uthread_t tids[NUM_THREADS];
+    for (long i = 0; i < NUM_THREADS; ++i) {
+        //every fourth thread has its own stack
+        int tid = uthread_create_attr(shared_thread, (void*)i,
+                                      i % 4 ? &shared : &dedicated);
+        assert(tid > 0);
+        tids[i] = tid;
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        int retval = -1;
+        assert(!uthread_join(tids[i], &retval));
+        assert(retval == 0);
+    }
+    printf("Shared stack yield test: success.\n");
+}
+
+volatile int turn = 0;
+
+/*
+ * two threads take turns without ever yielding
+ * only preemption can get them to make progress
+ */
+int spinning_thread(void *arg)
+{
+    int me = (int)(long)arg;
+    char frame[128];
+    memset(frame, me, sizeof(frame));
+
+    for (int i = 0; i < 4; ++i) {
+        while(turn % 2 != me);
+        ++turn;
+    }
+    for (int i = 0; i < sizeof(frame); ++i)
+        if(frame[i] != me)
+            return 1;
+    return 0;
+}
+
+void test_preempt()
+{
+    uthread_attr_t shared;
+    assert(!uthread_attr_init(&shared));
+    assert(!uthread_attr_setsharedstack(&shared, 1));
+
+    int tid0 = uthread_create_attr(spinning_thread, (void*)0L, &shared);
+    int tid1 = uthread_create_attr(spinning_thread, (void*)1L, &shared);
+    int retval0 = -1, retval1 = -1;
+    assert(!uthread_join(tid0, &retval0));
+    assert(!uthread_join(tid1, &retval1));
+    assert(retval0 == 0 && retval1 == 0);
+    printf("Shared stack preemption test: success.\n");
+}
+
+int main(void)
+{
+    uthread_attr_t attr;
+    uthread_attr_init(&attr);
+    if(uthread_attr_setsharedstack(&attr, 1)){
+        printf("Shared stacks not supported by this build, skipped.\n");
+        return 0;
+    }
+
+    test_yield();
+    test_preempt();
+    return 0;
+}
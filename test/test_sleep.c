@@ -0,0 +1,182 @@
+/*
+ * Sleep test
+ *
+ * Sleeping threads wake up in order, never early, even while another thread
+ * keeps the CPU busy, a kernel thread with only sleeping threads sleeps too,
+ * and joining a thread can time out, with one or several workers.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define MS 1000000ull
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define NUM_SLEEPERS 50
+//timers are rounded up, and we read the clock before the library does
+#define DEADLINE_SLACK_NS MS
+
+static uint64_t deadlines[NUM_SLEEPERS];
+static int wakeOrder[NUM_SLEEPERS];
+static int numAwake;
+static pthread_mutex_t orderLock = PTHREAD_MUTEX_INITIALIZER;
+
+int sleeper(void *arg)
+{
+    long i = (long)arg;
+    uint64_t ns = (NUM_SLEEPERS - i) * 2 * MS;
+    uint64_t start = now_ns();
+
+    deadlines[i] = start + ns;
+    assert(!uthread_sleep_ns(ns));
+    assert(now_ns() - start >= ns);
+    pthread_mutex_lock(&orderLock);
+    wakeOrder[numAwake++] = i;
+    pthread_mutex_unlock(&orderLock);
+    return 0;
+}
+
+/*
+ * threads created first sleep the longest, and wake up in
+ * the order of their deadlines, if @ordered is set: with
+ * several workers, a thread which woke up first may get to
+ * run later
+ * the deadlines are only 2ms apart, and threads may start
+ * late enough to reach theirs after a thread created later
+ */
+void sleepers_main(bool ordered)
+{
+    uthread_t tids[NUM_SLEEPERS];
+
+    numAwake = 0;
+    for (long i = 0; i < NUM_SLEEPERS; ++i)
+        tids[i] = uthread_create(sleeper, (void*)i);
+    for (int i = 0; i < NUM_SLEEPERS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(numAwake == NUM_SLEEPERS);
+    for (int i = 1; i < NUM_SLEEPERS && ordered; ++i)
+        assert(deadlines[wakeOrder[i - 1]] <= deadlines[wakeOrder[i]] + DEADLINE_SLACK_NS);
+}
+
+void test_order(void)
+{
+    sleepers_main(true);
+    printf("Wake up order test: success.\n");
+}
+
+/*
+ * main sleeps alone: the kernel thread must sleep as well
+ */
+void test_idle(void)
+{
+    uint64_t start = now_ns();
+    clock_t cpuStart = clock();
+
+    assert(!uthread_sleep_ns(100 * MS));
+    assert(now_ns() - start >= 100 * MS);
+    assert(clock() - cpuStart < 25 * CLOCKS_PER_SEC / 1000);
+    printf("Idle sleep test: success.\n");
+}
+
+static volatile int sleeperAwake;
+
+int short_sleeper(void *arg)
+{
+    assert(!uthread_sleep_ns(10 * MS));
+    sleeperAwake = 1;
+    return 0;
+}
+
+/*
+ * a sleeping thread wakes up even if the running thread
+ * never yields
+ */
+void test_busy(void)
+{
+    sleeperAwake = 0;
+    uthread_t tid = uthread_create(short_sleeper, NULL);
+    uthread_yield();
+
+    uint64_t end = now_ns() + 5000 * MS;
+    while(!sleeperAwake && now_ns() < end)
+        ;
+    assert(sleeperAwake);
+    assert(!uthread_join(tid, NULL));
+    printf("Busy wait test: success.\n");
+}
+
+int slow(void *arg)
+{
+    uthread_sleep_ns(100 * MS);
+    return 42;
+}
+
+int quick(void *arg)
+{
+    return 7;
+}
+
+void join_timeout_main(void)
+{
+    int retval = 0;
+
+    uthread_t tid = uthread_create(slow, NULL);
+    assert(uthread_join_timeout(tid, &retval, 0) == 1);
+    uint64_t start = now_ns();
+    assert(uthread_join_timeout(tid, &retval, 10 * MS) == 1);
+    assert(now_ns() - start >= 10 * MS);
+    assert(retval == 0);
+    //it can be joined again
+    assert(uthread_join_timeout(tid, &retval, 5000 * MS) == 0);
+    assert(retval == 42);
+    assert(now_ns() - start < 5000 * MS);
+
+    tid = uthread_create(quick, NULL);
+    assert(uthread_join_timeout(tid, &retval, 5000 * MS) == 0);
+    assert(retval == 7);
+    assert(uthread_join_timeout(tid, &retval, 5000 * MS) == -1);
+}
+
+void test_join_timeout(void)
+{
+    join_timeout_main();
+    printf("Join timeout test: success.\n");
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(2));
+    sleepers_main(false);
+    join_timeout_main();
+    return NULL;
+}
+
+void test_workers(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Sleep with workers test: success.\n");
+}
+
+int main(void)
+{
+    test_order();
+    test_idle();
+    test_busy();
+    test_join_timeout();
+    test_workers();
+    return 0;
+}
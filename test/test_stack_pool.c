@@ -0,0 +1,52 @@
+/*
+ * Stack pool test
+ *
+ * Creates and joins a large number of short-lived threads, with the stack pool
+ * prefilled, then trimmed in the middle of the run. Every thread must still
+ * get a usable stack and return its own value.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uthread.h>
+
+#define ROUNDS 2
+#define THREADS_PER_ROUND 5000
+#define BATCH 16
+
+int touch_stack(void *arg)
+{
+    //dirty a good part of the stack, so reused stacks are really reused
+    char buffer[8192];
+    memset(buffer, (int)(long)arg, sizeof(buffer));
+    return buffer[sizeof(buffer) - 1];
+}
+
+int main(void)
+{
+    assert(!uthread_stack_pool_config(BATCH, BATCH));
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (int i = 0; i < THREADS_PER_ROUND; i += BATCH) {
+            uthread_t tids[BATCH];
+            for (int j = 0; j < BATCH; ++j) {
+                int tid = uthread_create(touch_stack, (void*)(long)(j + 1));
+                assert(tid > 0);
+                tids[j] = tid;
+            }
+            for (int j = 0; j < BATCH; ++j) {
+                int retval;
+                assert(!uthread_join(tids[j], &retval));
+                assert(retval == j + 1);
+            }
+        }
+        //next round reuses stacks whose pages were dropped
+        uthread_stack_pool_trim();
+    }
+
+    printf("Stack pool test: success.\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Per-thread stack size test
+ *
+ * - a thread with a 1 MiB stack recurses deeper than the default stack size
+ * - a thread with the smallest allowed stack runs fine
+ * - a thread overflowing its stack hits the guard page and gets killed by
+ *   SIGSEGV instead of corrupting memory (checked in a child process)
+ */
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+/*
+ * each level uses about 1 KiB of stack
+ */
+int recurse(int depth)
+{
+    volatile unsigned char frame[1024];
+    memset((unsigned char*)frame, depth, sizeof(frame));
+    if(depth == 0)
+        return frame[0];
+    //count the frames that got corrupted
+    return recurse(depth - 1) + (frame[sizeof(frame) - 1] != (unsigned char)depth);
+}
+
+int deep_thread(void *arg)
+{
+    return recurse((int)(long)arg);
+}
+
+int tiny_thread(void *arg)
+{
+    return 42;
+}
+
+void test_big_stack()
+{
+    uthread_attr_t attr;
+    assert(!uthread_attr_init(&attr));
+    assert(!uthread_attr_setstacksize(&attr, 1 << 20));
+
+    //512 levels is way more than UTHREAD_STACK_SIZE
+    int tid = uthread_create_attr(deep_thread, (void*)512L, &attr);
+    int retval = -1;
+    assert(tid > 0);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == 0);
+    printf("Big stack test: success.\n");
+}
+
+void test_tiny_stack()
+{
+    uthread_attr_t attr;
+    assert(!uthread_attr_init(&attr));
+    assert(uthread_attr_setstacksize(&attr, UTHREAD_STACK_MIN - 1) == -1);
+    assert(!uthread_attr_setstacksize(&attr, UTHREAD_STACK_MIN));
+    assert(uthread_attr_setstacksize(NULL, UTHREAD_STACK_MIN) == -1);
+
+    int tid = uthread_create_attr(tiny_thread, NULL, &attr);
+    int retval = -1;
+    assert(tid > 0);
+    assert(!uthread_join(tid, &retval));
+    assert(retval == 42);
+    printf("Tiny stack test: success.\n");
+}
+
+void test_guard_page()
+{
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0){
+        uthread_attr_t attr;
+        uthread_attr_init(&attr);
+        uthread_attr_setstacksize(&attr, 16384);
+        uthread_join(uthread_create_attr(deep_thread, (void*)1000L, &attr), NULL);
+        //should never get here
+        exit(EXIT_SUCCESS);
+    }
+
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    printf("Guard page test: success.\n");
+}
+
+int main(void)
+{
+    test_guard_page();
+    test_big_stack();
+    test_tiny_stack();
+    return 0;
+}
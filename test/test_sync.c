@@ -0,0 +1,311 @@
+/*
+ * Synchronization test
+ *
+ * Mutexes protect shared state from preempted threads and are handed over in
+ * FIFO order, condition variables make a bounded buffer work, and semaphores
+ * count resources, with one or several workers. Free mutexes and available
+ * semaphores work without a scheduler.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define NUM_THREADS 8
+#define ITERATIONS 20000
+
+static uthread_mutex_t mutex;
+static long counter;
+
+int incrementer(void *arg)
+{
+    for (int i = 0; i < ITERATIONS; ++i) {
+        uthread_mutex_lock(&mutex);
+        //a preempted thread must not let others in
+        long value = counter;
+        if(i % 100 == 0)
+            uthread_yield();
+        counter = value + 1;
+        uthread_mutex_unlock(&mutex);
+    }
+    return 0;
+}
+
+void counter_main(void)
+{
+    uthread_t tids[NUM_THREADS];
+
+    uthread_mutex_init(&mutex);
+    counter = 0;
+    for (int i = 0; i < NUM_THREADS; ++i)
+        tids[i] = uthread_create(incrementer, NULL);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(counter == NUM_THREADS * ITERATIONS);
+}
+
+void test_counter(void)
+{
+    counter_main();
+    printf("Mutex counter test: success.\n");
+}
+
+static int order[NUM_THREADS];
+static int numLocked;
+
+int locker(void *arg)
+{
+    uthread_mutex_lock(&mutex);
+    order[numLocked++] = (long)arg;
+    uthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+/*
+ * threads get the mutex in the order they asked for it,
+ * even if we try to take it back right away
+ */
+void test_handoff(void)
+{
+    uthread_t tids[NUM_THREADS];
+
+    uthread_mutex_init(&mutex);
+    uthread_mutex_lock(&mutex);
+    for (long i = 0; i < NUM_THREADS; ++i) {
+        tids[i] = uthread_create(locker, (void*)i);
+        uthread_yield();
+    }
+    uthread_mutex_unlock(&mutex);
+    assert(uthread_mutex_trylock(&mutex) == -1);
+    uthread_mutex_lock(&mutex);
+    assert(numLocked == NUM_THREADS);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(order[i] == i);
+    uthread_mutex_unlock(&mutex);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    printf("Mutex handoff test: success.\n");
+}
+
+#define BUFFER_SIZE 4
+#define NUM_ITEMS 10000
+
+static int buffer[BUFFER_SIZE];
+static int head, length;
+static uthread_cond_t notEmpty, notFull;
+
+int producer(void *arg)
+{
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        uthread_mutex_lock(&mutex);
+        while(length == BUFFER_SIZE)
+            uthread_cond_wait(&notFull, &mutex);
+        buffer[(head + length++) % BUFFER_SIZE] = i;
+        uthread_cond_signal(&notEmpty);
+        uthread_mutex_unlock(&mutex);
+    }
+    return 0;
+}
+
+int consumer(void *arg)
+{
+    long sum = 0;
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        uthread_mutex_lock(&mutex);
+        while(!length)
+            uthread_cond_wait(&notEmpty, &mutex);
+        assert(buffer[head] == i);
+        sum += buffer[head];
+        head = (head + 1) % BUFFER_SIZE;
+        length--;
+        uthread_cond_signal(&notFull);
+        uthread_mutex_unlock(&mutex);
+    }
+    return sum == (long)NUM_ITEMS * (NUM_ITEMS - 1) / 2;
+}
+
+void buffer_main(void)
+{
+    int retval;
+
+    uthread_mutex_init(&mutex);
+    uthread_cond_init(&notEmpty);
+    uthread_cond_init(&notFull);
+    head = length = 0;
+    uthread_t consumerTid = uthread_create(consumer, NULL);
+    uthread_t producerTid = uthread_create(producer, NULL);
+    assert(!uthread_join(producerTid, NULL));
+    assert(!uthread_join(consumerTid, &retval));
+    assert(retval == 1);
+}
+
+void test_buffer(void)
+{
+    buffer_main();
+    printf("Bounded buffer test: success.\n");
+}
+
+static uthread_cond_t go;
+static int started, running;
+
+int waiter(void *arg)
+{
+    uthread_mutex_lock(&mutex);
+    started++;
+    uthread_cond_wait(&go, &mutex);
+    //we own the mutex: nobody else is between wait and unlock
+    assert(++running == 1);
+    uthread_yield();
+    running--;
+    uthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+void test_broadcast(void)
+{
+    uthread_t tids[NUM_THREADS];
+
+    uthread_mutex_init(&mutex);
+    uthread_cond_init(&go);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        tids[i] = uthread_create(waiter, NULL);
+    while(1){
+        uthread_mutex_lock(&mutex);
+        if(started == NUM_THREADS)
+            break;
+        uthread_mutex_unlock(&mutex);
+        uthread_yield();
+    }
+    uthread_cond_broadcast(&go);
+    uthread_mutex_unlock(&mutex);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    printf("Broadcast test: success.\n");
+}
+
+#define NUM_SLOTS 3
+
+static uthread_sem_t slots;
+static int inUse, maxInUse;
+
+int slot_user(void *arg)
+{
+    for (int i = 0; i < 100; ++i) {
+        uthread_sem_down(&slots);
+        uthread_mutex_lock(&mutex);
+        if(++inUse > maxInUse)
+            maxInUse = inUse;
+        uthread_mutex_unlock(&mutex);
+        uthread_yield();
+        uthread_mutex_lock(&mutex);
+        inUse--;
+        uthread_mutex_unlock(&mutex);
+        uthread_sem_up(&slots);
+    }
+    return 0;
+}
+
+/*
+ * all the slots get used at once if @full is set: with
+ * several workers, a thread may not switch when yielding
+ */
+void sem_main(bool full)
+{
+    uthread_t tids[NUM_THREADS];
+
+    uthread_mutex_init(&mutex);
+    assert(uthread_sem_init(&slots, -1) == -1);
+    assert(!uthread_sem_init(&slots, NUM_SLOTS));
+    inUse = maxInUse = 0;
+    for (int i = 0; i < NUM_THREADS; ++i)
+        tids[i] = uthread_create(slot_user, NULL);
+    for (int i = 0; i < NUM_THREADS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(maxInUse <= NUM_SLOTS);
+    assert(!full || maxInUse == NUM_SLOTS);
+    assert(uthread_sem_getvalue(&slots) == NUM_SLOTS);
+}
+
+void test_sem(void)
+{
+    sem_main(true);
+    printf("Semaphore test: success.\n");
+}
+
+void *workers_main(void *arg)
+{
+    assert(!uthread_workers_config(4));
+    counter_main();
+    buffer_main();
+    sem_main(false);
+    return NULL;
+}
+
+void test_workers(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, workers_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Synchronization with workers test: success.\n");
+}
+
+#define FAST_ITERATIONS 10000000
+
+/*
+ * uncontended operations never reach the scheduler, which
+ * this kernel thread does not even have
+ */
+void *fast_path_main(void *arg)
+{
+    uthread_mutex_t fast;
+    uthread_sem_t sem;
+    struct timespec start, end;
+
+    uthread_mutex_init(&fast);
+    assert(!uthread_sem_init(&sem, 1));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < FAST_ITERATIONS; ++i) {
+        uthread_mutex_lock(&fast);
+        uthread_mutex_unlock(&fast);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert(!uthread_mutex_trylock(&fast));
+    assert(uthread_mutex_trylock(&fast) == -1);
+    uthread_mutex_unlock(&fast);
+
+    assert(!uthread_sem_trydown(&sem));
+    assert(uthread_sem_trydown(&sem) == -1);
+    uthread_sem_up(&sem);
+    uthread_sem_down(&sem);
+    uthread_sem_up(&sem);
+    assert(uthread_sem_getvalue(&sem) == 1);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("Uncontended lock and unlock: %.1f ns\n", ns / FAST_ITERATIONS);
+    return NULL;
+}
+
+void test_fast_path(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, fast_path_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Fast path test: success.\n");
+}
+
+int main(void)
+{
+    test_fast_path();
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_MONOTONIC));
+    test_counter();
+    test_handoff();
+    test_buffer();
+    test_broadcast();
+    test_sem();
+    test_workers();
+    return 0;
+}
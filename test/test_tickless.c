@@ -0,0 +1,102 @@
+/*
+ * Tickless preemption test
+ *
+ * The timer only runs while another thread is ready, preemption works on both
+ * clocks, and it can be turned off.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <preempt.h>
+#include <uthread.h>
+
+static volatile int threadRan;
+
+int thread(void *arg)
+{
+    threadRan = 1;
+    return 0;
+}
+
+/*
+ * burn @ms milliseconds of CPU time, mostly in user mode
+ * rather than in clock()
+ */
+void spin(long ms)
+{
+    clock_t end = clock() + ms * CLOCKS_PER_SEC / 1000;
+    while(clock() < end)
+        for (volatile int i = 0; i < 100000; ++i)
+            ;
+}
+
+/*
+ * busy wait for a new thread, which only runs if we are preempted
+ */
+void test_preempted(void)
+{
+    threadRan = 0;
+    uthread_t tid = uthread_create(thread, NULL);
+    while(!threadRan)
+        ;
+    assert(!uthread_join(tid, NULL));
+}
+
+void test_tickless(void)
+{
+    assert(!preempt_armed());
+    threadRan = 0;
+    uthread_t tid = uthread_create(thread, NULL);
+    assert(preempt_armed());
+    assert(!uthread_join(tid, NULL));
+    assert(threadRan);
+
+    //the first tick finding us alone stops the timer
+    spin(50);
+    assert(!preempt_armed());
+    printf("Tickless test: success.\n");
+}
+
+void test_clocks(void)
+{
+    assert(uthread_preempt_config(1000, 42) == -1);
+    assert(uthread_preempt_config(2000000, UTHREAD_PREEMPT_CPU) == -1);
+
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_MONOTONIC));
+    test_preempted();
+
+    assert(!uthread_preempt_config(1000, UTHREAD_PREEMPT_CPU));
+    test_preempted();
+
+    //a whole second per slice
+    assert(!uthread_preempt_config(1, UTHREAD_PREEMPT_CPU));
+    threadRan = 0;
+    uthread_t tid = uthread_create(thread, NULL);
+    assert(preempt_armed());
+    assert(!uthread_join(tid, NULL));
+    assert(threadRan);
+    printf("Preemption clocks test: success.\n");
+}
+
+void test_disabled(void)
+{
+    assert(!uthread_preempt_config(0, UTHREAD_PREEMPT_CPU));
+    threadRan = 0;
+    uthread_t tid = uthread_create(thread, NULL);
+    assert(!preempt_armed());
+    spin(50);
+    assert(!threadRan);
+    assert(!uthread_join(tid, NULL));
+    assert(threadRan);
+    printf("Preemption disabled test: success.\n");
+}
+
+int main()
+{
+    test_tickless();
+    test_clocks();
+    test_disabled();
+    return 0;
+}
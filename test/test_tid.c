@@ -0,0 +1,78 @@
+/*
+ * TID test
+ *
+ * - more threads than fit in 16 bits can be created over time
+ * - TIDs of joined threads are reused, but a stale TID never reaches the
+ *   thread which reuses its slot
+ * - TIDs of live threads are all different
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <uthread.h>
+
+#define NUM_CREATIONS 100000
+#define NUM_ALIVE 1000
+
+int return_arg(void *arg)
+{
+    return (int)(long)arg;
+}
+
+void test_many_creations()
+{
+    for (int i = 0; i < NUM_CREATIONS; ++i) {
+        int tid = uthread_create(return_arg, (void*)(long)i);
+        int retval = -1;
+        assert(tid > 0);
+        assert(!uthread_join(tid, &retval));
+        assert(retval == i);
+    }
+    printf("Many creations test: success.\n");
+}
+
+void test_stale_tid()
+{
+    int tid = uthread_create(return_arg, NULL);
+    assert(tid > 0);
+    assert(!uthread_join(tid, NULL));
+
+    //tid is gone, and stays gone even once its slot is reused
+    assert(uthread_join(tid, NULL) == -1);
+    int newTid = uthread_create(return_arg, (void*)7L);
+    assert(newTid > 0 && newTid != tid);
+    assert(uthread_join(tid, NULL) == -1);
+
+    int retval = -1;
+    assert(!uthread_join(newTid, &retval));
+    assert(retval == 7);
+    printf("Stale TID test: success.\n");
+}
+
+void test_unique_tids()
+{
+    uthread_t tids[NUM_ALIVE];
+    for (int i = 0; i < NUM_ALIVE; ++i) {
+        int tid = uthread_create(return_arg, (void*)(long)i);
+        assert(tid > 0);
+        tids[i] = tid;
+        for (int j = 0; j < i; ++j)
+            assert(tids[j] != tids[i]);
+    }
+    for (int i = 0; i < NUM_ALIVE; ++i) {
+        int retval = -1;
+        assert(!uthread_join(tids[i], &retval));
+        assert(retval == i);
+    }
+    printf("Unique TIDs test: success.\n");
+}
+
+int main(void)
+{
+    test_many_creations();
+    test_stale_tid();
+    test_unique_tids();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <timer_wheel.h>
+
+#define TEST_TIMER_NUM 10000
+#define TEST_ROUNDS 2000
+#define TEST_SCALE_NUM 1000000
+
+typedef struct item {
+    uint64_t expires; //in ns
+    bool pending;
+    wheel_timer_t timer;
+} item;
+
+static item items[TEST_TIMER_NUM];
+
+static uint64_t random_u64(void)
+{
+    return (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ rand();
+}
+
+/*
+ * a delay spread over all the levels of the wheel
+ */
+static uint64_t random_delay(void)
+{
+    return random_u64() >> (8 + rand() % 56);
+}
+
+static uint64_t elapsed_ns(struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000000ull + end.tv_nsec - start->tv_nsec;
+}
+
+/*
+ * check that the timers which expire by @now are exactly
+ * the pending ones which are due, none early, at most a
+ * tick late
+ */
+static void expire_and_check(timer_wheel_t *wheel, uint64_t now)
+{
+    wheel_timer_t *timer;
+    while((timer = timer_wheel_expire(wheel, now)) != NULL){
+        item *it = timer_wheel_entry(timer, item, timer);
+        assert(it->pending);
+        assert(!timer_wheel_pending(timer));
+        assert(it->expires <= now);
+        it->pending = false;
+    }
+    for (int i = 0; i < TEST_TIMER_NUM; ++i)
+        assert(!items[i].pending || items[i].expires + TIMER_WHEEL_TICK_NS > now);
+}
+
+void test_random(void)
+{
+    timer_wheel_t wheel;
+    uint64_t now = random_u64() >> 8;
+    int count = 0;
+
+    timer_wheel_init(&wheel, now);
+    assert(timer_wheel_next(&wheel) == UINT64_MAX);
+    for (int i = 0; i < TEST_TIMER_NUM; ++i)
+        timer_wheel_timer_init(&items[i].timer);
+
+    for (int round = 0; round < TEST_ROUNDS; ++round) {
+        //add or cancel a few timers
+        for (int j = 0; j < 10; ++j) {
+            item *it = &items[rand() % TEST_TIMER_NUM];
+            if(it->pending){
+                timer_wheel_cancel(&wheel, &it->timer);
+                assert(!timer_wheel_pending(&it->timer));
+                it->pending = false;
+            }else{
+                it->expires = now + random_delay();
+                it->pending = true;
+                timer_wheel_add(&wheel, &it->timer, it->expires);
+            }
+        }
+
+        //no timer expires before the next deadline
+        uint64_t next = timer_wheel_next(&wheel);
+        uint64_t earliest = UINT64_MAX;
+        count = 0;
+        for (int i = 0; i < TEST_TIMER_NUM; ++i) {
+            if(!items[i].pending)
+                continue;
+            count++;
+            if(items[i].expires < earliest)
+                earliest = items[i].expires;
+        }
+        assert(timer_wheel_count(&wheel) == count);
+        assert(next <= earliest + TIMER_WHEEL_TICK_NS);
+
+        //jump to the next deadline, or somewhere before it
+        if(next != UINT64_MAX)
+            now = rand() % 2 ? next : now + (next - now) / 2;
+        expire_and_check(&wheel, now);
+    }
+
+    //a time in the past expires right away
+    timer_wheel_cancel(&wheel, &items[0].timer);
+    timer_wheel_add(&wheel, &items[0].timer, now / 2);
+    items[0].pending = true;
+    items[0].expires = now;
+    now += TIMER_WHEEL_TICK_NS;
+    expire_and_check(&wheel, now);
+    assert(!items[0].pending);
+
+    //everything eventually expires
+    expire_and_check(&wheel, UINT64_MAX);
+    assert(timer_wheel_count(&wheel) == 0);
+    printf("Random timers test: success.\n");
+}
+
+/*
+ * adding and cancelling timers costs the same whatever
+ * the number of pending timers
+ */
+void test_scale(void)
+{
+    timer_wheel_t wheel;
+    wheel_timer_t *timers = malloc(TEST_SCALE_NUM * sizeof(wheel_timer_t));
+    struct timespec start;
+    assert(timers);
+
+    timer_wheel_init(&wheel, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < TEST_SCALE_NUM; ++i)
+        timer_wheel_add(&wheel, &timers[i], random_delay());
+    assert(timer_wheel_count(&wheel) == TEST_SCALE_NUM);
+    for (int i = 0; i < TEST_SCALE_NUM; ++i)
+        timer_wheel_cancel(&wheel, &timers[i]);
+    uint64_t ns = elapsed_ns(&start);
+
+    assert(timer_wheel_count(&wheel) == 0);
+    assert(timer_wheel_next(&wheel) == UINT64_MAX);
+    printf("%d timers added and cancelled in %.1f ns each\n",
+           TEST_SCALE_NUM, (double)ns / TEST_SCALE_NUM / 2);
+    free(timers);
+    printf("Scale test: success.\n");
+}
+
+int main(void)
+{
+    srand(42);
+    test_random();
+    test_scale();
+    return 0;
+}
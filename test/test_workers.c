@@ -0,0 +1,172 @@
+/*
+ * M:N scheduling test
+ *
+ * Threads run on several kernel threads, and a task graph of threads creating
+ * and joining each other, as well as threads yielding in a loop, give the same
+ * results as with a single kernel thread.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define NUM_WORKERS 4
+
+/*
+ * fibonacci, one thread per call
+ */
+int fib(void *arg)
+{
+    long n = (long)arg;
+    if(n < 2)
+        return n;
+
+    int a, b;
+    uthread_t left = uthread_create(fib, (void*)(n - 1));
+    uthread_t right = uthread_create(fib, (void*)(n - 2));
+    assert(left != -1 && right != -1);
+    assert(!uthread_join(left, &a));
+    assert(!uthread_join(right, &b));
+    return a + b;
+}
+
+void test_task_graph(void)
+{
+    int result;
+    uthread_t tid = uthread_create(fib, (void*)15L);
+    assert(!uthread_join(tid, &result));
+    assert(result == 610);
+    printf("Task graph test: success.\n");
+}
+
+#define NUM_YIELDERS 16
+#define YIELDS 1000
+
+static atomic_long counter;
+
+int yielder(void *arg)
+{
+    for (int i = 0; i < YIELDS; ++i) {
+        atomic_fetch_add(&counter, 1);
+        uthread_yield();
+    }
+    return (long)arg;
+}
+
+void test_yield(void)
+{
+    uthread_t tids[NUM_YIELDERS];
+    for (long i = 0; i < NUM_YIELDERS; ++i)
+        tids[i] = uthread_create(yielder, (void*)i);
+
+    for (int i = 0; i < NUM_YIELDERS; ++i) {
+        int retval;
+        assert(!uthread_join(tids[i], &retval));
+        assert(retval == i);
+    }
+    assert(counter == NUM_YIELDERS * YIELDS);
+    printf("Yield test: success.\n");
+}
+
+#define NUM_SPINNERS 8
+#define TIMEOUT_SEC 10
+
+static atomic_long kernelTids[NUM_WORKERS];
+static atomic_int numKernelTids;
+
+/*
+ * record the kernel thread we run on
+ */
+static void record_kernel_tid(void)
+{
+    long tid = syscall(SYS_gettid);
+    for (int i = 0; i < NUM_WORKERS; ++i) {
+        long expected = 0;
+        if(atomic_load(&kernelTids[i]) == tid)
+            return;
+        if(atomic_compare_exchange_strong(&kernelTids[i], &expected, tid)){
+            atomic_fetch_add(&numKernelTids, 1);
+            return;
+        }
+        if(expected == tid)
+            return;
+    }
+    assert(0);
+}
+
+int spinner(void *arg)
+{
+    time_t end = time(NULL) + TIMEOUT_SEC;
+    while(atomic_load(&numKernelTids) < 2 && time(NULL) < end){
+        record_kernel_tid();
+        uthread_yield();
+    }
+    return 0;
+}
+
+void test_kernel_threads(void)
+{
+    uthread_t tids[NUM_SPINNERS];
+    for (int i = 0; i < NUM_SPINNERS; ++i)
+        tids[i] = uthread_create(spinner, NULL);
+    for (int i = 0; i < NUM_SPINNERS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(numKernelTids >= 2);
+    printf("Kernel threads test: success.\n");
+}
+
+/*
+ * main only runs on the kernel thread which initialized
+ * the library: this one can return to its caller
+ */
+void *pinned_main(void *arg)
+{
+    long tid = syscall(SYS_gettid);
+    assert(!uthread_workers_config(2));
+
+    uthread_t tids[NUM_YIELDERS];
+    for (long i = 0; i < NUM_YIELDERS; ++i)
+        tids[i] = uthread_create(yielder, (void*)i);
+    for (int i = 0; i < YIELDS; ++i) {
+        uthread_yield();
+        assert(syscall(SYS_gettid) == tid);
+    }
+    for (int i = 0; i < NUM_YIELDERS; ++i)
+        assert(!uthread_join(tids[i], NULL));
+    assert(syscall(SYS_gettid) == tid);
+    return NULL;
+}
+
+void test_pinned_main(void)
+{
+    pthread_t pthread;
+    assert(!pthread_create(&pthread, NULL, pinned_main, NULL));
+    assert(!pthread_join(pthread, NULL));
+    printf("Pinned main test: success.\n");
+}
+
+int main(void)
+{
+    assert(uthread_workers_config(-1) == -1);
+    assert(!uthread_workers_config(NUM_WORKERS));
+
+    test_task_graph();
+    assert(uthread_workers_config(1) == -1);
+
+    //no shared stack with several workers
+    uthread_attr_t attr;
+    uthread_attr_init(&attr);
+    if(!uthread_attr_setsharedstack(&attr, 1))
+        assert(uthread_create_attr(fib, 0, &attr) == -1);
+
+    test_yield();
+    test_kernel_threads();
+    test_pinned_main();
+    return 0;
+}